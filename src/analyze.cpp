@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "epd.h"
+#include "nnue.h"
+#include "pgn.h"
+#include "search.h"
+#include "str_util.h"
+#include "tablebase.h"
+#include "thread_pool.h"
+#include "uci.h"
+
+namespace {
+    using namespace choco;
+
+    void printUsage() {
+        std::cerr << "usage: johnner_analyze <file.epd> [--depth N | --nodes N | --movetime MS] [--threads N]\n"
+                  << "                       [--hash MB] [--tb DIR] [--out FILE] [--OPTION VALUE]...\n"
+                  << "acd, acn and acs operations on a line override the depth, nodes and seconds for that position;\n"
+                  << "--hash is split between the threads and --OPTION VALUE sets a UCI option on every search"
+                  << std::endl;
+    }
+
+    // results that may wait for an earlier, slower position before they are written, per thread
+    constexpr uint64_t PENDING_PER_THREAD = 64;
+
+    struct Arguments {
+        std::string input;
+        std::string out;
+        std::string tablebases;
+        SearchBounds bounds = { std::numeric_limits<int32_t>::max(), 0, 0 };
+        size_t threads = 0;
+        size_t hashMb = 0;
+        std::vector<std::pair<std::string, std::string>> options;
+    };
+
+    template<typename T>
+    bool parseInto(std::string_view text, T& target) {
+        std::optional<T> value = util::parseNumber<T>(text);
+        if (value) target = *value;
+        return value.has_value();
+    }
+
+    bool parseArguments(int argc, char* argv[], Arguments& args) {
+        for (int i = 1; i < argc; i++) {
+            std::string_view flag = argv[i];
+            if (!flag.starts_with("--")) {
+                if (!args.input.empty()) return false;
+                args.input = flag;
+                continue;
+            }
+            if (i + 1 >= argc) return false;
+            std::string_view value = argv[++i];
+
+            bool ok = true;
+            if (flag == "--depth") {
+                ok = parseInto(value, args.bounds.depth) && args.bounds.depth > 0;
+            } else if (flag == "--nodes") {
+                ok = parseInto(value, args.bounds.nodes) && args.bounds.nodes > 0;
+            } else if (flag == "--movetime") {
+                ok = parseInto(value, args.bounds.moveTime) && args.bounds.moveTime > 0;
+            } else if (flag == "--threads") {
+                ok = parseInto(value, args.threads) && args.threads > 0;
+            } else if (flag == "--hash") {
+                ok = parseInto(value, args.hashMb) && args.hashMb > 0;
+            } else if (flag == "--out") {
+                args.out = value;
+            } else if (flag == "--tb") {
+                args.tablebases = value;
+            } else {
+                args.options.emplace_back(flag.substr(2), value);
+            }
+
+            if (!ok) return false;
+        }
+
+        // without any limit, analyze each position to a fixed depth
+        if (args.bounds.depth == 0 && args.bounds.nodes == 0 && args.bounds.moveTime == std::numeric_limits<int32_t>::max()) {
+            args.bounds.depth = 10;
+        }
+        return !args.input.empty();
+    }
+
+    void appendJsonString(std::string& out, std::string_view text) {
+        out += '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if ((unsigned char) c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    // the default limits, with acd (depth), acn (nodes) and acs (seconds) from the EPD line on top
+    SearchBounds positionBounds(const SearchBounds& defaults, std::string_view operations) {
+        SearchBounds bounds = defaults;
+        if (auto depth = epd::findOperation(operations, "acd")) {
+            parseInto(*depth, bounds.depth);
+        }
+        if (auto nodes = epd::findOperation(operations, "acn")) {
+            parseInto(*nodes, bounds.nodes);
+        }
+        if (auto seconds = epd::findOperation(operations, "acs")) {
+            int64_t value;
+            if (parseInto(*seconds, value)) bounds.moveTime = value * 1000;
+        }
+        return bounds;
+    }
+
+    std::string analyze(Search& search, const epd::Record& record, const SearchBounds& defaults) {
+        std::string json = "{\"line\":" + std::to_string(record.line) + ",\"fen\":";
+        appendJsonString(json, record.fen);
+        if (auto id = epd::findOperation(record.operations, "id")) {
+            json += ",\"id\":";
+            appendJsonString(json, *id);
+        }
+
+        Board board;
+        const char* error = nullptr;
+        if (!board.loadFen(record.fen, &error)) {
+            json += ",\"error\":";
+            appendJsonString(json, error);
+            return json + "}";
+        }
+
+        // every position starts from an empty table, so results don't depend on which thread ran what
+        search.setBoard<true>(board);
+        auto start = std::chrono::steady_clock::now();
+        search.search(positionBounds(defaults, record.operations));
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+        Move best = search.getBestMove();
+        if (!isValidPiece(best.pieceType)) {
+            bool inCheck = board.bitboards[board.state.activeColor][KING] & board.getAttacks(oppositeSide(board.state.activeColor));
+            json += ",\"error\":";
+            appendJsonString(json, inCheck ? "checkmate" : "stalemate");
+            return json + "}";
+        }
+
+        UciScore score = search.getUciScore();
+        json += ",\"bestmove\":\"" + moveToUci(best) + "\"";
+        json += ",\"san\":\"" + pgn::moveToSan(board, best) + "\"";
+        json += ",\"score\":{\"" + std::string(score.mate ? "mate" : "cp") + "\":" + std::to_string(score.value) + "}";
+        json += ",\"depth\":" + std::to_string(search.getDepth());
+
+        json += ",\"pv\":[";
+        std::vector<Move> pv = search.getPv();
+        if (pv.empty()) pv.push_back(best);
+        for (size_t i = 0; i < pv.size(); i++) {
+            json += (i ? ",\"" : "\"") + moveToUci(pv[i]) + "\"";
+        }
+        json += "]";
+
+        json += ",\"nodes\":" + std::to_string(search.getNodes());
+        json += ",\"time_ms\":" + std::to_string(elapsed);
+        return json + "}";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+    if (!nnue::loadEmbedded()) {
+        nnue::loadFile("johnner.nnue");
+    }
+
+    if (!args.tablebases.empty()) tb::load(args.tablebases);
+
+    epd::Reader reader;
+    if (!reader.open(args.input)) {
+        std::cerr << "cannot open " << args.input << std::endl;
+        return 1;
+    }
+
+    std::FILE* out = args.out.empty() ? stdout : std::fopen(args.out.c_str(), "w");
+    if (!out) {
+        std::cerr << "cannot open " << args.out << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(args.threads);
+    // each search gets its own slice of the hash budget
+    size_t hashMb = args.hashMb ? std::max<size_t>(args.hashMb / pool.size(), 1) : 16;
+    const uint64_t window = PENDING_PER_THREAD * pool.size();
+
+    // positions are handed out one at a time in file order, so an idle thread always takes the
+    // next one; finished results wait in pending until everything before them is written
+    std::mutex mutex;
+    std::condition_variable written;
+    uint64_t nextIndex = 0;
+    uint64_t nextToWrite = 0;
+    std::map<uint64_t, std::string> pending;
+    bool optionsOk = true;
+
+    std::vector<std::future<void>> workers;
+    for (size_t worker = 0; worker < pool.size(); worker++) {
+        workers.push_back(pool.submit([&]() {
+            UciOptions options;
+            Search search{ Board() };
+            search.options.uciOutput = false;
+            addSearchOptions(options, search);
+            options.set("Hash", std::to_string(hashMb));
+            for (const auto& [option, value] : args.options) {
+                if (options.set(option, value) != UciOptions::SetResult::OK) {
+                    std::lock_guard lock(mutex);
+                    optionsOk = false;
+                    return;
+                }
+            }
+
+            while (true) {
+                epd::Record record;
+                uint64_t index;
+                {
+                    std::unique_lock lock(mutex);
+                    // don't run so far ahead of a slow position that pending grows without bound
+                    written.wait(lock, [&]() { return nextIndex < nextToWrite + window; });
+                    if (!optionsOk || !reader.next(record)) return;
+                    index = nextIndex++;
+                }
+
+                std::string result = analyze(search, record, args.bounds);
+
+                std::lock_guard lock(mutex);
+                pending.emplace(index, std::move(result));
+                while (!pending.empty() && pending.begin()->first == nextToWrite) {
+                    std::fputs(pending.begin()->second.c_str(), out);
+                    std::fputc('\n', out);
+                    pending.erase(pending.begin());
+                    nextToWrite++;
+                }
+                std::fflush(out);
+                written.notify_all();
+            }
+        }));
+    }
+
+    for (auto& worker : workers) worker.get();
+    if (out != stdout && std::fclose(out) != 0) {
+        std::cerr << "could not write " << args.out << std::endl;
+        return 1;
+    }
+    if (!optionsOk) {
+        std::cerr << "invalid UCI option" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -11,9 +11,12 @@
 #include <functional>
 #include <unordered_map>
 
+#include "kpk.h"
 #include "macros.h"
+#include "psqt.h"
 #include "types.h"
 #include "str_util.h"
+#include "zobrist.h"
 
 
 #define ALL_OCCUPIED_SQUARES (occupiedSquares[SIDE_WHITE] | occupiedSquares[SIDE_BLACK])
@@ -83,10 +86,24 @@ namespace choco {
             return attacks;
         }
     
-        inline uint64_t shiftLeftBasedOnColor(uint8_t color, uint64_t val, uint8_t amount) {
-            if (color == SIDE_WHITE) return val << amount;
+        template<uint8_t Color>
+        constexpr uint64_t shiftLeftBasedOnColor(uint64_t val, uint8_t amount) {
+            if constexpr (Color == SIDE_WHITE) return val << amount;
             else return val >> amount;
         }
+
+        inline uint64_t shiftLeftBasedOnColor(uint8_t color, uint64_t val, uint8_t amount) {
+            return (color == SIDE_WHITE) ? shiftLeftBasedOnColor<SIDE_WHITE>(val, amount)
+                                         : shiftLeftBasedOnColor<SIDE_BLACK>(val, amount);
+        }
+
+        // the part of the zobrist key that doesn't come from pieces
+        inline uint64_t stateKey(const GameState& state) {
+            uint64_t key = ZOBRIST.castling[state.castling];
+            if (IS_VALID_SQUARE(state.enpassantSquare)) key ^= ZOBRIST.enpassant[getFile(state.enpassantSquare)];
+            if (state.activeColor == SIDE_BLACK) key ^= ZOBRIST.blackToMove;
+            return key;
+        }
     }
 
     struct Magic {
@@ -298,6 +315,7 @@ namespace choco {
         uint64_t bishopIterations = initBishopBoards(BISHOP_SEED);
         initKnightBoards();
         initKingBoards();
+        kpk::init();
     }
 
     bool UnmakeMove::isValid() const {
@@ -320,131 +338,197 @@ namespace choco {
     }
 
     Board::Board() {
+        clear();
+    }
+
+    Board::Board(std::string_view fen) : Board() {
+        loadFen(fen);
+    }
+
+    void Board::clear() {
         memset(bitboards, 0, sizeof(bitboards));
         occupiedSquares[SIDE_WHITE] = 0;
         occupiedSquares[SIDE_BLACK] = 0;
         state = { SIDE_WHITE, 0, 0, INVALID_SQUARE, 0 };
+        psqt = 0;
+        phase = 0;
+        key = stateKey(state);
+        pawnKey = 0;
+        accumulator.dirty[SIDE_WHITE] = accumulator.dirty[SIDE_BLACK] = true;
+        savedPerspectives.clear();
     }
 
-    Board::Board(std::string fen) : Board() {
-        std::vector<std::string> fenParts = util::split(fen, " ");
-        
-        // piece positions
-        std::vector<std::string> positions = util::split(fenParts[0], "/");
-        for (int rank = 0; rank < 8; rank++) {
-            const std::string& row = positions[7 - rank];
-            int file = 0;
-            
-            for (size_t strIndex = 0; strIndex < row.length() && file < 8; strIndex++) {
-                uint8_t index = getIndex(rank, file);
-                switch(row[strIndex]) {
-                    case 'K':
-                        putPiece(SIDE_WHITE, KING, index);
-                    break;
-                    case 'Q':
-                        putPiece(SIDE_WHITE, QUEEN, index);
-                    break;
-                    case 'B':
-                        putPiece(SIDE_WHITE, BISHOP, index);
-                    break;
-                    case 'N':
-                        putPiece(SIDE_WHITE, KNIGHT, index);
-                    break;
-                    case 'R':
-                        putPiece(SIDE_WHITE, ROOK, index);
-                    break;
-                    case 'P':
-                        putPiece(SIDE_WHITE, PAWN, index);
-                    break;
-
-                    case 'k':
-                        putPiece(SIDE_BLACK, KING, index);
-                    break;
-                    case 'q':
-                        putPiece(SIDE_BLACK, QUEEN, index);
-                    break;
-                    case 'b':
-                        putPiece(SIDE_BLACK, BISHOP, index);
-                    break;
-                    case 'n':
-                        putPiece(SIDE_BLACK, KNIGHT, index);
-                    break;
-                    case 'r':
-                        putPiece(SIDE_BLACK, ROOK, index);
-                    break;
-                    case 'p':
-                        putPiece(SIDE_BLACK, PAWN, index);
-                    break;
-
-                    default: // numeric
-                        int val = row[strIndex] - '0';
-                        file += val - 1;
-                    break;
-                }
+    bool Board::loadFen(std::string_view fen, const char** error) {
+        auto fail = [this, error](const char* message) {
+            clear();
+            if (error) *error = message;
+            return false;
+        };
+
+        clear();
+        key ^= stateKey(state);
+
+        // piece positions, rank 8 first
+        static constexpr std::string_view PIECE_CHARS = "kqbnrp";
+        std::string_view placement = util::nextToken(fen);
+        int rank = 7;
+        int file = 0;
+        for (char c : placement) {
+            if (c == '/') {
+                if (file != 8 || rank == 0) return fail("rank with the wrong number of squares");
+                rank--;
+                file = 0;
+            } else if (c >= '1' && c <= '8') {
+                file += c - '0';
+                if (file > 8) return fail("rank with the wrong number of squares");
+            } else {
+                size_t piece = PIECE_CHARS.find((char) std::tolower((unsigned char) c));
+                if (piece == std::string_view::npos) return fail("unknown piece");
+                if (file >= 8) return fail("rank with the wrong number of squares");
+
+                putPiece(std::islower((unsigned char) c) ? SIDE_BLACK : SIDE_WHITE, (uint8_t) piece, getIndex(rank, file));
                 file++;
             }
         }
-    
+        if (rank != 0 || file != 8) return fail("board without 8 ranks of 8 squares");
+
+        if (countOnes(bitboards[SIDE_WHITE][KING]) != 1 || countOnes(bitboards[SIDE_BLACK][KING]) != 1) {
+            return fail("each side needs exactly one king");
+        }
+        if ((bitboards[SIDE_WHITE][PAWN] | bitboards[SIDE_BLACK][PAWN]) & (BITBOARD_RANK_1 | BITBOARD_RANK_8)) {
+            return fail("pawn on the first or last rank");
+        }
+
         // turn
-        state.activeColor = (fenParts[1] == "w") ? SIDE_WHITE : SIDE_BLACK;
+        std::string_view turn = util::nextToken(fen);
+        if (turn != "w" && turn != "b") return fail("side to move is not w or b");
+        state.activeColor = (turn == "w") ? SIDE_WHITE : SIDE_BLACK;
 
         // castling
-        const std::string& castlingString = fenParts[2];
-        if (castlingString.find('K') != std::string::npos) state.enableCastling(SIDE_WHITE, KING);
-        if (castlingString.find('Q') != std::string::npos) state.enableCastling(SIDE_WHITE, QUEEN);
-        if (castlingString.find('k') != std::string::npos) state.enableCastling(SIDE_BLACK, KING);
-        if (castlingString.find('q') != std::string::npos) state.enableCastling(SIDE_BLACK, QUEEN);
+        std::string_view castling = util::nextToken(fen);
+        if (castling.empty()) return fail("missing castling rights");
+        if (castling != "-") {
+            for (char c : castling) {
+                uint8_t side = std::islower((unsigned char) c) ? SIDE_BLACK : SIDE_WHITE;
+                uint8_t sidePiece;
+                uint8_t rookSquare;
+                switch (c) {
+                    case 'K': sidePiece = KING;  rookSquare = H1; break;
+                    case 'Q': sidePiece = QUEEN; rookSquare = A1; break;
+                    case 'k': sidePiece = KING;  rookSquare = H8; break;
+                    case 'q': sidePiece = QUEEN; rookSquare = A8; break;
+                    default: return fail("invalid castling rights");
+                }
+                // makeMove only moves the pieces from their starting squares
+                uint8_t kingSquare = side == SIDE_WHITE ? E1 : E8;
+                if (!(bitboards[side][KING] & getMask(kingSquare)) || !(bitboards[side][ROOK] & getMask(rookSquare))) {
+                    return fail("castling rights without the king and rook on their starting squares");
+                }
+                state.enableCastling(side, sidePiece);
+            }
+        }
 
         // en passant
-        const std::string& passantString = fenParts[3];
-        if (passantString.length() == 2) {
-            uint8_t passantFile = passantString[0] - 'a';
-            uint8_t passantRank = passantString[1] - '0' - 1;
-            state.enpassantSquare = getIndex(passantRank, passantFile);
+        std::string_view passant = util::nextToken(fen);
+        if (passant.empty()) return fail("missing en passant square");
+        if (passant != "-") {
+            uint8_t passantRank = state.activeColor == SIDE_WHITE ? '6' : '3';
+            if (passant.size() != 2 || passant[0] < 'a' || passant[0] > 'h' || passant[1] != passantRank) {
+                return fail("invalid en passant square");
+            }
+            state.enpassantSquare = getIndex(passant[1] - '1', passant[0] - 'a');
         }
 
-        // half moves
-        state.halfMoveClock = std::stoi(fenParts[4]);
-        
-        // full moves
-        state.moveCount = std::stoi(fenParts[5]);
+        // move counters, which EPD leaves out
+        std::string_view halfMoves = util::nextToken(fen);
+        std::string_view fullMoves = util::nextToken(fen);
+        if (!halfMoves.empty()) {
+            std::optional<uint8_t> clock = util::parseNumber<uint8_t>(halfMoves);
+            if (!clock) return fail("invalid halfmove clock");
+            state.halfMoveClock = *clock;
+        }
+        if (!fullMoves.empty()) {
+            std::optional<uint16_t> count = util::parseNumber<uint16_t>(fullMoves);
+            if (!count) return fail("invalid fullmove number");
+            state.moveCount = *count;
+        }
+        if (!util::trim(fen).empty()) return fail("trailing characters");
+
+        key ^= stateKey(state);
+        return true;
+    }
+
+    void Board::placePiece(uint8_t side, uint8_t piece, uint8_t square) {
+        putPiece(side, piece, square);
+    }
+
+    void Board::setState(const GameState& newState) {
+        key ^= stateKey(state);
+        state = newState;
+        key ^= stateKey(state);
     }
 
     Board::Board(const Board& other) {
-        std::memcpy(bitboards, other.bitboards, sizeof(bitboards));
-        occupiedSquares[SIDE_WHITE] = other.occupiedSquares[SIDE_WHITE];
-        occupiedSquares[SIDE_BLACK] = other.occupiedSquares[SIDE_BLACK];
-        state = other.state;
+        *this = other;
     }
 
     inline void Board::putPiece(uint8_t side, uint8_t piece, uint8_t index) {
         uint64_t mask = getMask(index);
         bitboards[side][piece] |= mask;
         occupiedSquares[side] |= mask;
+
+        psqt += PSQT[side][piece][index];
+        phase += PHASE_WEIGHTS[piece];
+        key ^= ZOBRIST.pieces[side][piece][index];
+        if (piece == PAWN) pawnKey ^= ZOBRIST.pieces[side][PAWN][index];
+
+        if (nnue::isEnabled()) updateAccumulator<true>(side, piece, index);
     }
     inline void Board::removePiece(uint8_t side, uint8_t piece, uint8_t index) {
         uint64_t mask = ~getMask(index);
-        bitboards[side][piece] &= ~getMask(index);
+        bitboards[side][piece] &= mask;
         occupiedSquares[side] &= mask;
+
+        psqt -= PSQT[side][piece][index];
+        phase -= PHASE_WEIGHTS[piece];
+        key ^= ZOBRIST.pieces[side][piece][index];
+        if (piece == PAWN) pawnKey ^= ZOBRIST.pieces[side][PAWN][index];
+
+        if (nnue::isEnabled()) updateAccumulator<false>(side, piece, index);
+    }
+
+    template<bool add>
+    inline void Board::updateAccumulator(uint8_t side, uint8_t piece, uint8_t index) {
+        uint8_t kingSquares[2] = {
+            bitboards[SIDE_WHITE][KING] ? countTrailingZeros(bitboards[SIDE_WHITE][KING]) : (uint8_t) INVALID_SQUARE,
+            bitboards[SIDE_BLACK][KING] ? countTrailingZeros(bitboards[SIDE_BLACK][KING]) : (uint8_t) INVALID_SQUARE
+        };
+        nnue::updatePiece<add>(accumulator, kingSquares, side, piece, index);
     }
     UnmakeMove Board::makeMove(const Move& move) {
         UnmakeMove unmakeMove = { move, INVALID_PIECE, state };
 
-        uint64_t movementMask = getMask(move.from) | getMask(move.to);
-        bitboards[state.activeColor][move.pieceType] ^= movementMask;
-        occupiedSquares[state.activeColor] ^= movementMask;
+        // a king move invalidates the mover's perspective; keep it for unmakeMove
+        if (move.pieceType == KING && nnue::isEnabled() && !accumulator.dirty[state.activeColor]) {
+            nnue::SavedPerspective& saved = savedPerspectives.emplace_back();
+            std::memcpy(saved.values, accumulator.values[state.activeColor], sizeof(saved.values));
+            saved.generation = accumulator.generation;
+            unmakeMove.accumulatorSaved = true;
+        }
+
+        key ^= stateKey(state);
+
+        removePiece(state.activeColor, move.pieceType, move.from);
+        putPiece(state.activeColor, move.pieceType, move.to);
 
         state.halfMoveClock++;
 
         // capture
-        for (uint8_t i = 0; i < 6; i++) {
-            uint64_t initialVal = bitboards[OPPOSITE_SIDE(state.activeColor)][i];
-            removePiece(OPPOSITE_SIDE(state.activeColor), i, move.to);
-            if (initialVal != bitboards[OPPOSITE_SIDE(state.activeColor)][i]) {
-                state.halfMoveClock = 0;
-                unmakeMove.pieceTaken = i;
-                break;
-            }
+        uint8_t captured = getPieceOnSquare(bitboards[OPPOSITE_SIDE(state.activeColor)], move.to);
+        if (IS_VALID_PIECE(captured)) {
+            removePiece(OPPOSITE_SIDE(state.activeColor), captured, move.to);
+            state.halfMoveClock = 0;
+            unmakeMove.pieceTaken = captured;
         }
 
         uint64_t illegalAttackSquares = 0; // squares that are not allowed be attacked if this move is played
@@ -484,7 +568,7 @@ namespace choco {
                     removePiece(SIDE_WHITE, ROOK, A1);
                     putPiece(SIDE_WHITE, ROOK, D1);
                 } else {
-                    illegalAttackSquares |= getMask(G1);
+                    illegalAttackSquares |= getMask(F1);
                     removePiece(SIDE_WHITE, ROOK, H1);
                     putPiece(SIDE_WHITE, ROOK, F1);
                 }
@@ -512,8 +596,11 @@ namespace choco {
         if (move.from == H8 || move.to == H8) state.disableCastling(SIDE_BLACK, KING);
 
         illegalAttackSquares |= bitboards[state.activeColor][KING];
+        if (state.activeColor == SIDE_BLACK) state.moveCount++;
         state.activeColor = OPPOSITE_SIDE(state.activeColor);
 
+        key ^= stateKey(state);
+
         // lazy move legality check. does not check for king attack as engine will avoid moves like that at all costs
         if (illegalAttackSquares && (illegalAttackSquares & getAttacks(state.activeColor))) {
             this->unmakeMove(unmakeMove);
@@ -524,8 +611,15 @@ namespace choco {
     }
 
     void Board::unmakeMove(const UnmakeMove& unmakeMove) {
+        key ^= stateKey(state);
         state = unmakeMove.state;
-        removePiece(state.activeColor, unmakeMove.move.pieceType, unmakeMove.move.to);
+        key ^= stateKey(state);
+
+        // a promoted pawn is no longer a pawn on its destination square
+        uint8_t movedPiece = IS_VALID_PIECE(unmakeMove.move.promotionType)
+                             ? unmakeMove.move.promotionType
+                             : unmakeMove.move.pieceType;
+        removePiece(state.activeColor, movedPiece, unmakeMove.move.to);
         putPiece(state.activeColor, unmakeMove.move.pieceType, unmakeMove.move.from);
 
         // castling spaghetti^-1
@@ -554,140 +648,237 @@ namespace choco {
             putPiece(OPPOSITE_SIDE(state.activeColor), unmakeMove.pieceTaken, unmakeMove.move.to);
         }
 
-        // promotion
-        if (IS_VALID_PIECE(unmakeMove.move.promotionType)) {
-            removePiece(state.activeColor, unmakeMove.move.promotionType, unmakeMove.move.to);
-        }
-
         // en passant
         if (unmakeMove.move.pieceType == PAWN && unmakeMove.move.to == state.enpassantSquare) {
             int offset = (state.activeColor == SIDE_WHITE) ? 8 : -8;
             putPiece(OPPOSITE_SIDE(state.activeColor), PAWN, state.enpassantSquare - offset);
         }
+
+        if (unmakeMove.accumulatorSaved && !savedPerspectives.empty()) {
+            const nnue::SavedPerspective& saved = savedPerspectives.back();
+            // unless a different network was loaded in the meantime
+            if (saved.generation == accumulator.generation) {
+                std::memcpy(accumulator.values[state.activeColor], saved.values, sizeof(saved.values));
+                accumulator.dirty[state.activeColor] = false;
+            }
+            savedPerspectives.pop_back();
+        }
     }
 
+    MoveList Board::generatePLMoves() const {
+        return (state.activeColor == SIDE_WHITE) ? generatePLMoves<SIDE_WHITE>() : generatePLMoves<SIDE_BLACK>();
+    }
+
+    template<uint8_t Color>
     MoveList Board::generatePLMoves() const {
         MoveList moves;
         
-        addPawnMoves(moves);
-        addQueenMoves(moves);
-        addKnightMoves(moves);
-        addBishopMoves(moves);
-        addRookMoves(moves);
-        addKingMoves(moves);
+        addPawnMoves<Color>(moves);
+        addQueenMoves<Color>(moves);
+        addKnightMoves<Color>(moves);
+        addBishopMoves<Color>(moves);
+        addRookMoves<Color>(moves);
+        addKingMoves<Color>(moves);
 
         return moves;
     }
 
+    template<uint8_t Color>
     void Board::addKingMoves(MoveList& moves) const {
-        iterateIndices(bitboards[state.activeColor][KING], [this, &moves](uint8_t index) -> void {
-            addOriginExtractedMoves(plKingMoveBB(index, state.activeColor), KING, index, moves);
+        iterateIndices(bitboards[Color][KING], [this, &moves](uint8_t index) -> void {
+            addOriginExtractedMoves(plKingMoveBB(index, Color), KING, index, moves);
         });
 
         uint64_t occupied = ALL_OCCUPIED_SQUARES;
 
         // castling spaghetti
-        if (state.canCastle(state.activeColor, KING)) {
-            uint64_t mask = state.activeColor == SIDE_WHITE ? getMask(F1) | getMask(G1) : getMask(F8) | getMask(G8);
+        constexpr uint8_t kingSquare = (Color == SIDE_WHITE) ? E1 : E8;
+        if (state.canCastle(Color, KING)) {
+            constexpr uint64_t mask = (Color == SIDE_WHITE) ? getMask(F1) | getMask(G1) : getMask(F8) | getMask(G8);
             if ((occupied & mask) == 0) {
-                moves.push_back(state.activeColor == SIDE_WHITE ? Move(KING, E1, G1) : Move(KING, E8, G8));
+                moves.push_back(Move(KING, kingSquare, kingSquare + 2));
             }
         }
-        if (state.canCastle(state.activeColor, QUEEN)) {
-            uint64_t mask = (state.activeColor == SIDE_WHITE)
-                            ? getMask(D1) | getMask(C1) | getMask(B1)
-                            : getMask(D8) | getMask(C8) | getMask(B8);
+        if (state.canCastle(Color, QUEEN)) {
+            constexpr uint64_t mask = (Color == SIDE_WHITE)
+                                      ? getMask(D1) | getMask(C1) | getMask(B1)
+                                      : getMask(D8) | getMask(C8) | getMask(B8);
             if ((occupied & mask) == 0) {
-                moves.push_back(state.activeColor == SIDE_WHITE ? Move(KING, E1, C1) : Move(KING, E8, C8));
+                moves.push_back(Move(KING, kingSquare, kingSquare - 2));
             }
         }
     }
 
+    template<uint8_t Color>
     void Board::addQueenMoves(MoveList& moves) const {
-        iterateIndices(bitboards[state.activeColor][QUEEN], [this, &moves](uint8_t index) -> void {
-            addOriginExtractedMoves(plQueenMoveBB(index, state.activeColor), QUEEN, index, moves);
+        iterateIndices(bitboards[Color][QUEEN], [this, &moves](uint8_t index) -> void {
+            addOriginExtractedMoves(plQueenMoveBB(index, Color), QUEEN, index, moves);
         });
     }
 
+    template<uint8_t Color>
     void Board::addKnightMoves(MoveList& moves) const {
-        iterateIndices(bitboards[state.activeColor][KNIGHT], [this, &moves](uint8_t index) -> void {
-            addOriginExtractedMoves(plKnightMoveBB(index, state.activeColor), KNIGHT, index, moves);
+        iterateIndices(bitboards[Color][KNIGHT], [this, &moves](uint8_t index) -> void {
+            addOriginExtractedMoves(plKnightMoveBB(index, Color), KNIGHT, index, moves);
         });
     }
 
+    template<uint8_t Color>
     void Board::addBishopMoves(MoveList& moves) const {
-        iterateIndices(bitboards[state.activeColor][BISHOP], [this, &moves](uint8_t index) -> void {
-            addOriginExtractedMoves(plBishopMoveBB(index, state.activeColor), BISHOP, index, moves);
+        iterateIndices(bitboards[Color][BISHOP], [this, &moves](uint8_t index) -> void {
+            addOriginExtractedMoves(plBishopMoveBB(index, Color), BISHOP, index, moves);
         });
     }
 
+    template<uint8_t Color>
     void Board::addRookMoves(MoveList& moves) const {
-        iterateIndices(bitboards[state.activeColor][ROOK], [this, &moves](uint8_t index) -> void {
-            addOriginExtractedMoves(plRookMoveBB(index, state.activeColor), ROOK, index, moves);
+        iterateIndices(bitboards[Color][ROOK], [this, &moves](uint8_t index) -> void {
+            addOriginExtractedMoves(plRookMoveBB(index, Color), ROOK, index, moves);
         });
     }
 
     static constexpr uint64_t PAWN_LEFT_MASK[2]  = { BITBOARD_FILE_H, BITBOARD_FILE_A };
     static constexpr uint64_t PAWN_RIGHT_MASK[2] = { BITBOARD_FILE_A, BITBOARD_FILE_H };
 
+    template<uint8_t Color>
     void Board::addPawnMoves(MoveList& moves) const {
-        int shiftFactor = state.activeColor == SIDE_WHITE ? 1 : -1;
-
-        if (!bitboards[state.activeColor][PAWN]) return;
+        constexpr int shiftFactor = (Color == SIDE_WHITE) ? 1 : -1;
+        constexpr uint64_t promoterMask = (Color == SIDE_WHITE) ? BITBOARD_RANK_7 : BITBOARD_RANK_2;
+        constexpr uint64_t doublePushRankMask = (Color == SIDE_WHITE) ? BITBOARD_RANK_3 : BITBOARD_RANK_6;
+        constexpr uint64_t promotedMask = (Color == SIDE_WHITE) ? BITBOARD_RANK_8 : BITBOARD_RANK_1;
 
-        uint8_t color = state.activeColor;
+        uint64_t pawns = bitboards[Color][PAWN];
+        if (!pawns) return;
 
         // pushes
         uint64_t emptySquares = ~(ALL_OCCUPIED_SQUARES);
-        uint64_t promoterMask = (color == SIDE_WHITE) ? BITBOARD_RANK_7 : BITBOARD_RANK_2;
-        uint64_t pushedPawns = shiftLeftBasedOnColor(color, bitboards[color][PAWN] & ~promoterMask, 8) & emptySquares;
+        uint64_t pushedPawns = shiftLeftBasedOnColor<Color>(pawns & ~promoterMask, 8) & emptySquares;
         addOffsetExtractedMoves(pushedPawns, PAWN, 8 * shiftFactor, moves);
 
         // double pushes
-        uint64_t doublePushRankMask = (color == SIDE_WHITE) ? BITBOARD_RANK_3 : BITBOARD_RANK_6;
-        uint64_t doublePushedPawns = shiftLeftBasedOnColor(color, pushedPawns & doublePushRankMask, 8) & emptySquares;
+        uint64_t doublePushedPawns = shiftLeftBasedOnColor<Color>(pushedPawns & doublePushRankMask, 8) & emptySquares;
         addOffsetExtractedMoves(doublePushedPawns, PAWN, 16 * shiftFactor, moves);
 
-        uint64_t promotedMask = (color == SIDE_WHITE) ? BITBOARD_RANK_8 : BITBOARD_RANK_1;
-
         // captures
-        uint64_t oppSquares = occupiedSquares[OPPOSITE_SIDE(color)];
+        uint64_t oppSquares = occupiedSquares[oppositeSide(Color)];
         if (IS_VALID_SQUARE(state.enpassantSquare)) oppSquares |= getMask(state.enpassantSquare);
-        uint64_t captureLPawns = shiftLeftBasedOnColor(color, bitboards[color][PAWN] & ~PAWN_RIGHT_MASK[color], 7) & oppSquares;
-        uint64_t captureRPawns = shiftLeftBasedOnColor(color, bitboards[color][PAWN] & ~PAWN_LEFT_MASK[color], 9) & oppSquares;
+        uint64_t captureLPawns = shiftLeftBasedOnColor<Color>(pawns & ~PAWN_RIGHT_MASK[Color], 7) & oppSquares;
+        uint64_t captureRPawns = shiftLeftBasedOnColor<Color>(pawns & ~PAWN_LEFT_MASK[Color], 9) & oppSquares;
         addOffsetExtractedMoves(captureLPawns & ~promotedMask, PAWN, 7 * shiftFactor, moves);
         addOffsetExtractedMoves(captureRPawns & ~promotedMask, PAWN, 9 * shiftFactor, moves);
         addOffsetExtractedPromotionMoves(captureLPawns & promotedMask, 7 * shiftFactor, moves);
         addOffsetExtractedPromotionMoves(captureRPawns & promotedMask, 9 * shiftFactor, moves);
 
         // promotion
-        uint64_t promotedPawns = shiftLeftBasedOnColor(color, bitboards[color][PAWN] & promoterMask, 8) & emptySquares;
+        uint64_t promotedPawns = shiftLeftBasedOnColor<Color>(pawns & promoterMask, 8) & emptySquares;
         addOffsetExtractedPromotionMoves(promotedPawns, 8 * shiftFactor, moves);
     }
 
+    namespace {
+        inline uint64_t rookAttacks(uint8_t square, uint64_t occupied) {
+            const Magic& val = ROOK_TBL[square];
+            return ROOK_ATTACKS[square][((occupied & val.mask) * val.magic) >> (64 - 12)];
+        }
+
+        inline uint64_t bishopAttacks(uint8_t square, uint64_t occupied) {
+            const Magic& val = BISHOP_TBL[square];
+            return BISHOP_ATTACKS[square][((occupied & val.mask) * val.magic) >> (64 - 9)];
+        }
+
+        // whether Color attacks square given the occupancy, ignoring Color's pieces on excluded squares
+        template<uint8_t Color>
+        inline bool isAttacked(const Board& board, uint8_t square, uint64_t occupied, uint64_t excluded) {
+            const uint64_t* pieces = board.bitboards[Color];
+            uint64_t mask = getMask(square);
+
+            // a pawn of the other color on square attacks exactly the squares Color's pawns attack it from
+            constexpr uint8_t other = oppositeSide(Color);
+            uint64_t pawnSources = shiftLeftBasedOnColor<other>(mask & ~PAWN_RIGHT_MASK[other], 7)
+                                 | shiftLeftBasedOnColor<other>(mask & ~PAWN_LEFT_MASK[other], 9);
+
+            return ((pieces[PAWN] & pawnSources)
+                    | (pieces[KNIGHT] & KNIGHT_ATTACKS[square])
+                    | (pieces[KING] & KING_ATTACKS[square])
+                    | ((pieces[BISHOP] | pieces[QUEEN]) & bishopAttacks(square, occupied))
+                    | ((pieces[ROOK] | pieces[QUEEN]) & rookAttacks(square, occupied))) & ~excluded;
+        }
+    }
+
+    bool Board::isLegal(const Move& move) const {
+        return (state.activeColor == SIDE_WHITE) ? isLegal<SIDE_WHITE>(move) : isLegal<SIDE_BLACK>(move);
+    }
+
+    template<uint8_t Color>
+    bool Board::isLegal(const Move& move) const {
+        constexpr uint8_t them = oppositeSide(Color);
+        uint64_t occupied = ALL_OCCUPIED_SQUARES;
+
+        // castling: the king may not start in, pass through or land in check
+        if (move.pieceType == KING && unsignedDist(move.from, move.to) == 2) {
+            uint8_t step = (move.to > move.from) ? 1 : -1;
+            for (uint8_t square = move.from; square != (uint8_t) (move.to + step); square += step) {
+                if (isAttacked<them>(*this, square, occupied, 0)) return false;
+            }
+            return true;
+        }
+
+        uint64_t fromMask = getMask(move.from);
+        uint64_t toMask = getMask(move.to);
+        uint64_t captured = toMask;
+
+        if (move.pieceType == PAWN && move.to == state.enpassantSquare) {
+            captured |= getMask(Color == SIDE_WHITE ? move.to - 8 : move.to + 8);
+        }
+
+        uint64_t after = ((occupied & ~fromMask) | toMask) & ~(captured & ~toMask);
+        uint8_t kingSquare = (move.pieceType == KING) ? move.to : countTrailingZeros(bitboards[Color][KING]);
+
+        return !isAttacked<them>(*this, kingSquare, after, captured);
+    }
+
+    MoveList Board::generateLegalMoves() const {
+        return (state.activeColor == SIDE_WHITE) ? generateLegalMoves<SIDE_WHITE>() : generateLegalMoves<SIDE_BLACK>();
+    }
+
+    template<uint8_t Color>
+    MoveList Board::generateLegalMoves() const {
+        MoveList plMoves = generatePLMoves<Color>();
+        MoveList moves;
+
+        for (const Move& move : plMoves) {
+            if (isLegal<Color>(move)) moves.push_back(move);
+        }
+
+        return moves;
+    }
+
     uint64_t Board::getAttacks(uint8_t color) const {
+        return (color == SIDE_WHITE) ? getAttacks<SIDE_WHITE>() : getAttacks<SIDE_BLACK>();
+    }
+
+    template<uint8_t Color>
+    uint64_t Board::getAttacks() const {
         uint64_t attacks = 0;
-        iterateIndices(bitboards[color][KING], [this, color, &attacks](uint8_t index) -> void {
-            attacks |= plKingMoveBB(index, color);
+        iterateIndices(bitboards[Color][KING], [this, &attacks](uint8_t index) -> void {
+            attacks |= plKingMoveBB(index, Color);
         });
-        iterateIndices(bitboards[color][QUEEN], [this, color, &attacks](uint8_t index) -> void {
-            attacks |= plQueenMoveBB(index, color);
+        iterateIndices(bitboards[Color][QUEEN], [this, &attacks](uint8_t index) -> void {
+            attacks |= plQueenMoveBB(index, Color);
         });
-        iterateIndices(bitboards[color][KNIGHT], [this, color, &attacks](uint8_t index) -> void {
-            attacks |= plKnightMoveBB(index, color);
+        iterateIndices(bitboards[Color][KNIGHT], [this, &attacks](uint8_t index) -> void {
+            attacks |= plKnightMoveBB(index, Color);
         });
-        iterateIndices(bitboards[color][BISHOP], [this, color, &attacks](uint8_t index) -> void {
-            attacks |= plBishopMoveBB(index, color);
+        iterateIndices(bitboards[Color][BISHOP], [this, &attacks](uint8_t index) -> void {
+            attacks |= plBishopMoveBB(index, Color);
         });
-        iterateIndices(bitboards[color][ROOK], [this, color, &attacks](uint8_t index) -> void {
-            attacks |= plRookMoveBB(index, color);
+        iterateIndices(bitboards[Color][ROOK], [this, &attacks](uint8_t index) -> void {
+            attacks |= plRookMoveBB(index, Color);
         });
 
         // pawns
-        uint64_t captureLPawns = shiftLeftBasedOnColor(color, bitboards[color][PAWN] & ~PAWN_RIGHT_MASK[color], 7);
-        uint64_t captureRPawns = shiftLeftBasedOnColor(color, bitboards[color][PAWN] & ~PAWN_LEFT_MASK[color], 9);
-        attacks |= captureLPawns;
-        attacks |= captureRPawns;
+        uint64_t pawns = bitboards[Color][PAWN];
+        attacks |= shiftLeftBasedOnColor<Color>(pawns & ~PAWN_RIGHT_MASK[Color], 7);
+        attacks |= shiftLeftBasedOnColor<Color>(pawns & ~PAWN_LEFT_MASK[Color], 9);
         
         return attacks;
     }
@@ -792,10 +983,30 @@ namespace choco {
         occupiedSquares[SIDE_WHITE] = other.occupiedSquares[SIDE_WHITE];
         occupiedSquares[SIDE_BLACK] = other.occupiedSquares[SIDE_BLACK];
         state = other.state;
+        psqt = other.psqt;
+        phase = other.phase;
+        key = other.key;
+        pawnKey = other.pawnKey;
+        accumulator = other.accumulator;
+        savedPerspectives = other.savedPerspectives;
         return *this;
     }
 
 
+    uint64_t getHash(const Board& board) {
+        uint64_t hash = stateKey(board.state);
+
+        for (uint8_t color = 0; color < 2; color++) {
+            for (uint8_t piece = 0; piece < 6; piece++) {
+                iterateIndices(board.bitboards[color][piece], [&hash, color, piece](uint8_t index) {
+                    hash ^= ZOBRIST.pieces[color][piece][index];
+                });
+            }
+        }
+
+        return hash;
+    }
+
     std::string indexToPrettyString(uint8_t index) {
         return std::string(1, (index % 8) + 'a') + std::to_string(index / 8 + 1);
     }
@@ -849,6 +1060,44 @@ namespace choco {
         return str.erase(str.length() - 1);
     }
 
+    std::string boardToFen(const Board& board) {
+        static constexpr char PIECE_CHARS[2][6] = { { 'K', 'Q', 'B', 'N', 'R', 'P' }, { 'k', 'q', 'b', 'n', 'r', 'p' } };
+
+        std::string fen;
+        for (int rank = 7; rank >= 0; rank--) {
+            int empty = 0;
+            for (int file = 0; file < 8; file++) {
+                uint8_t square = getIndex(rank, file);
+                uint8_t side = (board.occupiedSquares[SIDE_WHITE] & getMask(square)) ? SIDE_WHITE : SIDE_BLACK;
+                uint8_t piece = getPieceOnSquare(board.bitboards[side], square);
+
+                if (!isValidPiece(piece)) {
+                    empty++;
+                    continue;
+                }
+                if (empty) fen += (char) ('0' + empty);
+                empty = 0;
+                fen += PIECE_CHARS[side][piece];
+            }
+            if (empty) fen += (char) ('0' + empty);
+            if (rank > 0) fen += '/';
+        }
+
+        fen += board.state.activeColor == SIDE_WHITE ? " w " : " b ";
+
+        std::string castling;
+        if (board.state.canCastle(SIDE_WHITE, KING))  castling += 'K';
+        if (board.state.canCastle(SIDE_WHITE, QUEEN)) castling += 'Q';
+        if (board.state.canCastle(SIDE_BLACK, KING))  castling += 'k';
+        if (board.state.canCastle(SIDE_BLACK, QUEEN)) castling += 'q';
+        fen += castling.empty() ? "-" : castling;
+
+        fen += ' ';
+        fen += IS_VALID_SQUARE(board.state.enpassantSquare) ? indexToPrettyString(board.state.enpassantSquare) : "-";
+
+        return fen + " " + std::to_string(board.state.halfMoveClock) + " " + std::to_string(board.state.moveCount);
+    }
+
     std::string pieceToPrettyString(uint8_t piece) {
         switch (piece) {
             case KING: return "King";
@@ -3,9 +3,11 @@
 #include <cstdint>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
 
+#include "nnue.h"
 #include "types.h"
 
 namespace choco {
@@ -30,6 +32,7 @@ namespace choco {
         // does not include en passant (it is implied in unmakeMove())
         uint8_t pieceTaken;
         GameState state;
+        bool accumulatorSaved; // the mover's perspective was pushed onto Board::savedPerspectives
 
         bool isValid() const;
     };
@@ -43,13 +46,34 @@ namespace choco {
     class Board {
     public:
         Board();
-        Board(std::string fen);
+        // an empty board if the FEN is invalid; use loadFen to find out
+        Board(std::string_view fen);
         Board(const Board& other);
 
+        // Sets up the position without allocating. The move counters may be left out, as in EPD.
+        // On failure the board is cleared and error, if given, points to a static description.
+        bool loadFen(std::string_view fen, const char** error = nullptr);
+
+        // Sets up a position directly, for callers that already have it in binary form: clear(),
+        // placePiece() for every piece, then setState(). Nothing is validated.
+        void clear();
+        void placePiece(uint8_t side, uint8_t piece, uint8_t square);
+        void setState(const GameState& newState);
+
         uint64_t bitboards[2][6];
         uint64_t occupiedSquares[2];
         GameState state;
 
+        // incrementally updated evaluation terms
+        int32_t psqt;  // packed mg/eg material + piece-square score, white's point of view
+        uint8_t phase; // sum of PHASE_WEIGHTS of all pieces on the board
+        uint64_t key;     // zobrist key of the whole position
+        uint64_t pawnKey; // zobrist key of the pawns alone
+
+        // first layer of the network; only maintained while a network is loaded
+        mutable nnue::Accumulator accumulator;
+        std::vector<nnue::SavedPerspective> savedPerspectives;
+
         /**
          * @brief Makes a move and sets up game state for the next turn. Move must be pseudo-legal.
          * If the move was invalid, nothing will occur and INVALID_MOVE will be return
@@ -61,13 +85,10 @@ namespace choco {
         void unmakeMove(const UnmakeMove& move);
 
         MoveList generatePLMoves() const;
+        MoveList generateLegalMoves() const;
 
-        void addKingMoves(MoveList& moves) const;
-        void addQueenMoves(MoveList& moves) const;
-        void addKnightMoves(MoveList& moves) const;
-        void addBishopMoves(MoveList& moves) const;
-        void addRookMoves(MoveList& moves) const;
-        void addPawnMoves(MoveList& moves) const;
+        // whether a pseudo-legal move leaves the mover's king safe, without making it
+        bool isLegal(const Move& move) const;
 
         uint64_t plMoveBB(uint8_t pieceType, uint8_t square, uint8_t color) const;
 
@@ -86,12 +107,33 @@ namespace choco {
         Board& operator=(const Board& other);
 
     private:
+        // the public generators dispatch once on the side to move, so colors, shifts and rank masks
+        // below are compile-time constants
+        template<uint8_t Color> MoveList generatePLMoves() const;
+        template<uint8_t Color> MoveList generateLegalMoves() const;
+        template<uint8_t Color> bool isLegal(const Move& move) const;
+        template<uint8_t Color> uint64_t getAttacks() const;
+
+        template<uint8_t Color> void addKingMoves(MoveList& moves) const;
+        template<uint8_t Color> void addQueenMoves(MoveList& moves) const;
+        template<uint8_t Color> void addKnightMoves(MoveList& moves) const;
+        template<uint8_t Color> void addBishopMoves(MoveList& moves) const;
+        template<uint8_t Color> void addRookMoves(MoveList& moves) const;
+        template<uint8_t Color> void addPawnMoves(MoveList& moves) const;
+
         inline void putPiece(uint8_t side, uint8_t piece, uint8_t index);
         inline void removePiece(uint8_t side, uint8_t piece, uint8_t index);
+
+        template<bool add>
+        inline void updateAccumulator(uint8_t side, uint8_t piece, uint8_t index);
     };
 
+    // zobrist key computed from scratch; Board::key holds the same value, updated incrementally
+    uint64_t getHash(const Board& board);
+
     std::string indexToPrettyString(uint8_t index);
     std::string bitboardToPrettyString(uint64_t bitboard);
     std::string boardToPrettyString(const Board& board);
+    std::string boardToFen(const Board& board);
     std::string pieceToPrettyString(uint8_t piece);
 } // namespace choco
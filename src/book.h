@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "board.h"
+#include "mapped_file.h"
+#include "types.h"
+
+namespace choco {
+    // key of a position in Polyglot books. unrelated to Board::key, which uses its own random numbers
+    uint64_t polyglotKey(const Board& board);
+
+    // Polyglot .bin opening book: 16-byte big-endian entries (key, move, weight, learn) sorted by key.
+    // The file is memory mapped and binary searched, so loading is instant whatever the book's size.
+    class OpeningBook {
+    public:
+        bool load(const std::string& path);
+        void unload();
+
+        bool isLoaded() const {
+            return file.isOpen();
+        }
+        size_t size() const {
+            return file.size() / ENTRY_SIZE;
+        }
+
+        // a legal book move for the position, or nothing when the position isn't in the book.
+        // best picks the highest weighted move, otherwise moves are drawn in proportion to their weight
+        std::optional<Move> probe(const Board& board, bool best);
+    private:
+        static constexpr size_t ENTRY_SIZE = 16;
+
+        struct Entry {
+            uint64_t key;
+            uint16_t move;
+            uint16_t weight;
+        };
+        Entry entryAt(size_t index) const;
+
+        MappedFile file;
+        std::mt19937_64 rng{ std::random_device{}() };
+    };
+} // namespace choco
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "match.h"
+#include "nnue.h"
+#include "packed_position.h"
+#include "str_util.h"
+#include "thread_pool.h"
+
+namespace {
+    using namespace choco;
+    using namespace choco::match;
+
+    void printUsage() {
+        std::cerr << "usage: johnner_datagen --out FILE [--games N] [--threads N] [--nodes N]\n"
+                  << "                       [--random-plies N] [--seed N] [--OPTION VALUE]...\n"
+                  << "appends 32-byte records (see packed_position.h) to FILE; --OPTION VALUE sets a UCI option"
+                  << std::endl;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // positions are handed to the file in blocks of this many
+    constexpr size_t FLUSH_POSITIONS = 1 << 14;
+    // scores beyond this are mates or tablebase wins, which say nothing about the eval
+    constexpr int MAX_RECORDED_SCORE = 10000;
+
+    struct Arguments {
+        std::string out;
+        uint64_t games = 10000;
+        size_t threads = 0;
+        uint64_t nodes = 5000;
+        int randomPlies = 8;
+        uint64_t seed = 1;
+        std::vector<std::pair<std::string, std::string>> options;
+    };
+
+    template<typename T>
+    bool parseInto(std::string_view text, T& target) {
+        std::optional<T> value = util::parseNumber<T>(text);
+        if (value) target = *value;
+        return value.has_value();
+    }
+
+    bool parseArguments(int argc, char* argv[], Arguments& args) {
+        for (int i = 1; i < argc; i++) {
+            std::string_view flag = argv[i];
+            if (!flag.starts_with("--") || i + 1 >= argc) return false;
+            std::string_view value = argv[++i];
+
+            bool ok = true;
+            if (flag == "--out") {
+                args.out = value;
+            } else if (flag == "--games") {
+                ok = parseInto(value, args.games) && args.games > 0;
+            } else if (flag == "--threads") {
+                ok = parseInto(value, args.threads) && args.threads > 0;
+            } else if (flag == "--nodes") {
+                ok = parseInto(value, args.nodes) && args.nodes > 0;
+            } else if (flag == "--random-plies") {
+                ok = parseInto(value, args.randomPlies) && args.randomPlies >= 0;
+            } else if (flag == "--seed") {
+                ok = parseInto(value, args.seed);
+            } else {
+                args.options.emplace_back(flag.substr(2), value);
+            }
+
+            if (!ok) return false;
+        }
+        return !args.out.empty();
+    }
+
+    // the quiet positions of a finished game: not in check, and the engine's choice wasn't a
+    // capture or promotion, so the score is close to what a static eval should see
+    void recordGame(const Game& game, std::vector<PackedPosition>& positions) {
+        uint8_t result = game.result == Result::WHITE_WIN ? PackedPosition::RESULT_WHITE_WIN
+                       : game.result == Result::BLACK_WIN ? PackedPosition::RESULT_BLACK_WIN
+                       : PackedPosition::RESULT_DRAW;
+
+        Board board(game.fen);
+        for (size_t i = 0; i < game.moves.size(); i++) {
+            Move move = uciToMove(board, game.moves[i]);
+            uint8_t us = board.state.activeColor;
+
+            bool inCheck = board.bitboards[us][KING] & board.getAttacks(oppositeSide(us));
+            bool capture = (board.occupiedSquares[oppositeSide(us)] & getMask(move.to))
+                           || (move.pieceType == PAWN && move.to == board.state.enpassantSquare);
+            bool quiet = !inCheck && !capture && !isValidPiece(move.promotionType);
+
+            if (quiet && std::abs(game.scores[i]) <= MAX_RECORDED_SCORE) {
+                positions.push_back(packPosition(board, (int16_t) game.scores[i], result));
+            }
+            board.makeMove(move);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+    if (!nnue::loadEmbedded()) {
+        nnue::loadFile("johnner.nnue");
+    }
+
+    std::FILE* file = std::fopen(args.out.c_str(), "ab");
+    if (!file) {
+        std::cerr << "could not open " << args.out << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(args.threads);
+
+    TimeControl timeControl;
+    timeControl.nodes = args.nodes;
+    Adjudication adjudication;
+
+    std::mutex mutex;
+    std::atomic<uint64_t> nextGame = 0;
+    uint64_t gamesDone = 0;
+    uint64_t positionsWritten = 0;
+    bool failed = false;
+    auto start = std::chrono::steady_clock::now();
+
+    // under the lock: one fwrite per block, so blocks of different threads never interleave
+    auto flush = [&](std::vector<PackedPosition>& positions, uint64_t games) {
+        std::lock_guard lock(mutex);
+        if (std::fwrite(positions.data(), sizeof(PackedPosition), positions.size(), file) != positions.size()) {
+            failed = true;
+        }
+        positionsWritten += positions.size();
+        gamesDone += games;
+        positions.clear();
+
+        std::fprintf(stderr, "%llu games, %llu positions, %.0f positions/s\n", (unsigned long long) gamesDone,
+                     (unsigned long long) positionsWritten, positionsWritten / secondsSince(start));
+    };
+
+    std::vector<std::future<bool>> workers;
+    for (size_t worker = 0; worker < pool.size(); worker++) {
+        workers.push_back(pool.submit([&]() {
+            // one engine plays both sides, so it sees the game's whole history in its hash table
+            EnginePlayer engine("datagen");
+            for (const auto& [option, value] : args.options) {
+                if (!engine.setOption(option, value)) return false;
+            }
+
+            std::vector<PackedPosition> positions;
+            positions.reserve(FLUSH_POSITIONS + 1024);
+            uint64_t games = 0;
+
+            for (uint64_t index = nextGame++; index < args.games; index = nextGame++) {
+                std::string fen = randomOpening(args.randomPlies, args.seed + index);
+                Game game = playGame(engine, engine, fen, timeControl, adjudication);
+                recordGame(game, positions);
+                games++;
+
+                if (positions.size() >= FLUSH_POSITIONS) {
+                    flush(positions, games);
+                    games = 0;
+                }
+            }
+
+            if (games > 0) flush(positions, games);
+            return true;
+        }));
+    }
+
+    bool optionsOk = true;
+    for (auto& worker : workers) optionsOk &= worker.get();
+    failed |= std::fclose(file) != 0;
+
+    if (!optionsOk) {
+        std::cerr << "invalid UCI option" << std::endl;
+        return 1;
+    }
+    if (failed) {
+        std::cerr << "could not write " << args.out << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "epd.h"
+
+#include "str_util.h"
+
+namespace choco::epd {
+    Record parseLine(std::string_view line) {
+        line = util::trim(line);
+
+        // four fields, then the move counters if both are numbers
+        std::string_view rest = line;
+        for (int field = 0; field < 4; field++) util::nextToken(rest);
+
+        std::string_view counters = rest;
+        std::string_view halfMoves = util::nextToken(counters);
+        std::string_view fullMoves = util::nextToken(counters);
+        if (util::parseNumber<int>(halfMoves) && util::parseNumber<int>(fullMoves)) rest = counters;
+
+        Record record;
+        record.fen = util::trim(line.substr(0, line.size() - rest.size()));
+        record.operations = util::trim(rest);
+        return record;
+    }
+
+    std::optional<Operation> nextOperation(std::string_view& operations) {
+        while (true) {
+            operations = util::trim(operations);
+            if (operations.empty()) return std::nullopt;
+
+            // the end of this operation: the first semicolon outside quotes
+            size_t end = 0;
+            bool quoted = false;
+            for (; end < operations.size(); end++) {
+                if (operations[end] == '"') quoted = !quoted;
+                else if (operations[end] == ';' && !quoted) break;
+            }
+
+            std::string_view text = util::trim(operations.substr(0, end));
+            operations = end < operations.size() ? operations.substr(end + 1) : std::string_view();
+            if (text.empty()) continue;
+
+            Operation operation;
+            operation.opcode = util::nextToken(text);
+            operation.operand = util::trim(text);
+            if (operation.operand.size() >= 2 && operation.operand.front() == '"' && operation.operand.back() == '"') {
+                operation.operand = operation.operand.substr(1, operation.operand.size() - 2);
+            }
+            return operation;
+        }
+    }
+
+    std::optional<std::string_view> findOperation(std::string_view operations, std::string_view opcode) {
+        while (std::optional<Operation> operation = nextOperation(operations)) {
+            if (operation->opcode == opcode) return operation->operand;
+        }
+        return std::nullopt;
+    }
+
+    bool Reader::open(const std::string& path) {
+        line = 0;
+        if (!file.open(path)) {
+            rest = {};
+            return false;
+        }
+        rest = file.view();
+        return true;
+    }
+
+    bool Reader::next(Record& record) {
+        while (!rest.empty()) {
+            size_t newline = rest.find('\n');
+            std::string_view text = rest.substr(0, newline);
+            rest = newline == std::string_view::npos ? std::string_view() : rest.substr(newline + 1);
+            line++;
+
+            text = util::trim(text);
+            if (text.empty() || text[0] == '#') continue;
+
+            record = parseLine(text);
+            record.line = line;
+            return true;
+        }
+        return false;
+    }
+} // namespace choco::epd
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.h"
+
+namespace choco::epd {
+    // One line of an EPD file, e.g. `<fen> bm Nf3; id "pos 1";` or `<fen> ;D1 20 ;D2 400`. The views
+    // point into the mapped file and stay valid while the reader is open.
+    struct Record {
+        std::string_view fen;        // the four position fields, plus move counters if the line has them
+        std::string_view operations; // everything after the position
+        size_t line = 0;             // 1-based line number in the file
+    };
+
+    struct Operation {
+        std::string_view opcode;
+        std::string_view operand; // without surrounding quotes; may hold several tokens
+    };
+
+    // pops the next `opcode operand;` off the front of operations. Empty operations between
+    // semicolons are skipped and semicolons inside quotes don't end an operand
+    std::optional<Operation> nextOperation(std::string_view& operations);
+
+    // the operand of the first operation with the given opcode
+    std::optional<std::string_view> findOperation(std::string_view operations, std::string_view opcode);
+
+    // Streams the records of a memory-mapped EPD file without copying or allocating. Blank lines
+    // and lines starting with # are skipped.
+    class Reader {
+    public:
+        // false if the file can't be opened or is empty
+        bool open(const std::string& path);
+
+        // false once the file is exhausted
+        bool next(Record& record);
+
+        // where the reader is, for splitting work
+        size_t offset() const {
+            return file.size() - rest.size();
+        }
+        size_t size() const {
+            return file.size();
+        }
+    private:
+        MappedFile file;
+        std::string_view rest;
+        size_t line = 0;
+    };
+
+    // splits a line into its position and operations
+    Record parseLine(std::string_view line);
+} // namespace choco::epd
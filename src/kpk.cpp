@@ -0,0 +1,180 @@
+#include "kpk.h"
+
+#include <bitset>
+#include <vector>
+
+#include "bithelpers.h"
+#include "macros.h"
+
+namespace choco::kpk {
+    namespace {
+        // white king, black king, side to move (0 for white), pawn file a-d and pawn rank 2-7
+        constexpr uint32_t MAX_INDEX = 2 * 24 * 64 * 64;
+
+        std::bitset<MAX_INDEX> whiteWins;
+
+        constexpr uint32_t index(uint8_t whiteKing, uint8_t blackKing, uint8_t stm, uint8_t pawn) {
+            return whiteKing | (blackKing << 6) | (stm << 12) | (getFile(pawn) << 13) | ((6 - getRank(pawn)) << 15);
+        }
+
+        constexpr uint64_t kingAttacks(uint8_t square) {
+            uint64_t attacks = 0;
+            for (int dr = -1; dr <= 1; dr++) {
+                for (int df = -1; df <= 1; df++) {
+                    int rank = getRank(square) + dr;
+                    int file = getFile(square) + df;
+                    if ((dr || df) && rank >= 0 && rank < 8 && file >= 0 && file < 8) attacks |= getMask(rank, file);
+                }
+            }
+            return attacks;
+        }
+
+        struct KingAttacks {
+            uint64_t table[64];
+        };
+
+        constexpr KingAttacks makeKingAttacks() {
+            KingAttacks attacks{};
+            for (uint8_t square = 0; square < 64; square++) attacks.table[square] = kingAttacks(square);
+            return attacks;
+        }
+
+        constexpr KingAttacks KING_MOVES = makeKingAttacks();
+
+        constexpr uint64_t whitePawnAttacks(uint8_t pawn) {
+            uint64_t mask = getMask(pawn);
+            return ((mask & ~BITBOARD_FILE_A) << 7) | ((mask & ~BITBOARD_FILE_H) << 9);
+        }
+
+        // results are bit flags so the results of every move can be or-ed together
+        enum Result : uint8_t {
+            INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4
+        };
+
+        Result classifyInitial(uint8_t whiteKing, uint8_t blackKing, uint8_t stm, uint8_t pawn) {
+            if (unsignedDist(getRank(whiteKing), getRank(blackKing)) <= 1
+                && unsignedDist(getFile(whiteKing), getFile(blackKing)) <= 1) return INVALID;
+            if (whiteKing == pawn || blackKing == pawn) return INVALID;
+            if (stm == SIDE_WHITE && (whitePawnAttacks(pawn) & getMask(blackKing))) return INVALID;
+
+            uint8_t promotion = pawn + 8;
+
+            // the pawn promotes and the queen can't be taken
+            if (stm == SIDE_WHITE && getRank(pawn) == 6 && whiteKing != promotion && blackKing != promotion
+                && (!(KING_MOVES.table[blackKing] & getMask(promotion)) || (KING_MOVES.table[whiteKing] & getMask(promotion)))) {
+                return WIN;
+            }
+
+            if (stm == SIDE_BLACK) {
+                // stalemate
+                if (!(KING_MOVES.table[blackKing] & ~(KING_MOVES.table[whiteKing] | whitePawnAttacks(pawn)))) return DRAW;
+                // the pawn can be taken
+                if (KING_MOVES.table[blackKing] & getMask(pawn) & ~KING_MOVES.table[whiteKing]) return DRAW;
+            }
+
+            return UNKNOWN;
+        }
+
+        Result classify(const std::vector<Result>& db, uint8_t whiteKing, uint8_t blackKing, uint8_t stm, uint8_t pawn) {
+            // white needs one winning move, black one drawing move
+            Result good = (stm == SIDE_WHITE) ? WIN : DRAW;
+            Result bad = (stm == SIDE_WHITE) ? DRAW : WIN;
+
+            uint8_t results = INVALID;
+            uint64_t kingMoves = KING_MOVES.table[stm == SIDE_WHITE ? whiteKing : blackKing];
+
+            iterateIndices(kingMoves, [&](uint8_t square) {
+                results |= (stm == SIDE_WHITE) ? db[index(square, blackKing, SIDE_BLACK, pawn)]
+                                               : db[index(whiteKing, square, SIDE_WHITE, pawn)];
+            });
+
+            if (stm == SIDE_WHITE) {
+                // promotions are classified as wins up front
+                if (getRank(pawn) < 6) results |= db[index(whiteKing, blackKing, SIDE_BLACK, pawn + 8)];
+
+                if (getRank(pawn) == 1 && pawn + 8 != whiteKing && pawn + 8 != blackKing) {
+                    results |= db[index(whiteKing, blackKing, SIDE_BLACK, pawn + 16)];
+                }
+            }
+
+            if (results & good) return good;
+            if (results & UNKNOWN) return UNKNOWN;
+            return bad;
+        }
+
+        template<typename F>
+        void forEachPosition(F&& func) {
+            for (uint8_t pawnRank = 1; pawnRank <= 6; pawnRank++) {
+                for (uint8_t pawnFile = 0; pawnFile < 4; pawnFile++) {
+                    uint8_t pawn = getIndex(pawnRank, pawnFile);
+                    for (uint8_t stm = 0; stm < 2; stm++) {
+                        for (uint8_t blackKing = 0; blackKing < 64; blackKing++) {
+                            for (uint8_t whiteKing = 0; whiteKing < 64; whiteKing++) {
+                                func(whiteKing, blackKing, stm, pawn);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    void init() {
+        std::vector<Result> db(MAX_INDEX);
+
+        forEachPosition([&db](uint8_t whiteKing, uint8_t blackKing, uint8_t stm, uint8_t pawn) {
+            db[index(whiteKing, blackKing, stm, pawn)] = classifyInitial(whiteKing, blackKing, stm, pawn);
+        });
+
+        // a position stays unknown only while it depends on other unknown positions. once nothing
+        // changes, those are cycles white can't force out of, so they are draws
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            forEachPosition([&](uint8_t whiteKing, uint8_t blackKing, uint8_t stm, uint8_t pawn) {
+                uint32_t i = index(whiteKing, blackKing, stm, pawn);
+                if (db[i] != UNKNOWN) return;
+
+                db[i] = classify(db, whiteKing, blackKing, stm, pawn);
+                changed |= db[i] != UNKNOWN;
+            });
+        }
+
+        for (uint32_t i = 0; i < MAX_INDEX; i++) whiteWins[i] = db[i] == WIN;
+    }
+
+    bool isKpk(const Board& board) {
+        uint64_t occupied = board.occupiedSquares[SIDE_WHITE] | board.occupiedSquares[SIDE_BLACK];
+        uint64_t pawns = board.bitboards[SIDE_WHITE][PAWN] | board.bitboards[SIDE_BLACK][PAWN];
+        return countOnes(occupied) == 3 && countOnes(pawns) == 1;
+    }
+
+    bool probe(uint8_t strongKing, uint8_t pawn, uint8_t weakKing, bool strongToMove) {
+        // the bitbase only holds pawns on files a-d; mirror the rest
+        if (getFile(pawn) > 3) {
+            strongKing ^= 7;
+            weakKing ^= 7;
+            pawn ^= 7;
+        }
+
+        return whiteWins[index(strongKing, weakKing, strongToMove ? SIDE_WHITE : SIDE_BLACK, pawn)];
+    }
+
+    bool probe(const Board& board) {
+        uint8_t strong = board.bitboards[SIDE_WHITE][PAWN] ? SIDE_WHITE : SIDE_BLACK;
+        uint8_t weak = oppositeSide(strong);
+
+        uint8_t strongKing = countTrailingZeros(board.bitboards[strong][KING]);
+        uint8_t weakKing = countTrailingZeros(board.bitboards[weak][KING]);
+        uint8_t pawn = countTrailingZeros(board.bitboards[strong][PAWN]);
+
+        // flip black's pieces so the pawn moves up the board
+        if (strong == SIDE_BLACK) {
+            strongKing ^= 56;
+            weakKing ^= 56;
+            pawn ^= 56;
+        }
+
+        return probe(strongKing, pawn, weakKing, board.state.activeColor == strong);
+    }
+} // namespace choco::kpk
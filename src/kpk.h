@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include "board.h"
+
+// King and pawn vs king bitbase. Every position with the pawn's side normalized to white and the pawn
+// on files a-d is solved by retrograde iteration at startup (a few milliseconds) and stored as one
+// bit: whether white wins. 2 * 24 * 64 * 64 positions fit in 24 KB.
+namespace choco::kpk {
+    // called by initBitboards()
+    void init();
+
+    // whether the pieces on the board are two kings and a single pawn
+    bool isKpk(const Board& board);
+
+    // whether the side with the pawn wins; board must be a KPK position
+    bool probe(const Board& board);
+
+    // squares as seen by the pawn's side, strongToMove when that side is to move
+    bool probe(uint8_t strongKing, uint8_t pawn, uint8_t weakKing, bool strongToMove);
+} // namespace choco::kpk
@@ -1,5 +0,0 @@
-#include "macros.h"
-
-namespace choco {
-    uint64_t consideredMoves = 0;
-} // namespace choco
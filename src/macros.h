@@ -3,14 +3,6 @@
 #include <string>
 #include <cstdint>
 
-#define BOT_PERF_CTR
-
-#ifdef BOT_PERF_CTR
-namespace choco {
-    extern uint64_t consideredMoves;
-}
-#endif
-
 #define A1 (uint8_t)(0)
 #define B1 (uint8_t)(1)
 #define C1 (uint8_t)(2)
@@ -122,3 +114,16 @@ static constexpr uint64_t BITBOARD_FILE_H = 0x8080808080808080ULL;
 static constexpr int MAX_MOVES = 218;
 
 static const std::string STARTING_POS = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// searched by the bench command and timed by johnner_microbench: openings, middlegames, endgames
+// and the usual perft positions with castling, promotions and en passant
+static constexpr const char* BENCH_POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R b KQ - 3 8",
+    "8/5pk1/6p1/3P4/2P2K2/8/8/8 w - - 0 50",
+};
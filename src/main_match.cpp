@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "epd.h"
+#include "match.h"
+#include "nnue.h"
+#include "str_util.h"
+#include "thread_pool.h"
+
+namespace {
+    using namespace choco::match;
+
+    void printUsage() {
+        std::cerr << "usage: johnner_match --engine [cmd=PATH] [name=NAME] [OPTION=VALUE]... --engine ...\n"
+                  << "                     [--games N] [--concurrency N] [--tc BASE+INC | --movetime MS | --depth N | --nodes N]\n"
+                  << "                     [--openings FILE.epd | --random-plies N] [--seed N]\n"
+                  << "                     [--sprt ELO0 ELO1 [ALPHA BETA]] [--resign MOVES SCORE]\n"
+                  << "                     [--draw MOVENUMBER MOVES SCORE] [--maxmoves N]\n"
+                  << "without cmd=, an engine runs in this process with the given UCI options" << std::endl;
+    }
+
+    struct EngineSpec {
+        std::string command; // empty for an in-process engine
+        std::string name;
+        std::vector<std::pair<std::string, std::string>> options;
+    };
+
+    struct Arguments {
+        std::vector<EngineSpec> engines;
+        int games = 100;
+        int concurrency = 1;
+        TimeControl timeControl;
+        Adjudication adjudication;
+        std::string openings;
+        int randomPlies = 8;
+        uint64_t seed = 1;
+        std::optional<Sprt> sprt;
+    };
+
+    template<typename T>
+    bool parseInto(std::string_view text, T& target) {
+        std::optional<T> value = choco::util::parseNumber<T>(text);
+        if (value) target = *value;
+        return value.has_value();
+    }
+
+    // seconds with an optional increment: "10", "10+0.1"
+    bool parseTimeControl(std::string_view text, TimeControl& timeControl) {
+        size_t plus = text.find('+');
+        double base = 0;
+        double increment = 0;
+        if (!parseInto(text.substr(0, plus), base)) return false;
+        if (plus != std::string_view::npos && !parseInto(text.substr(plus + 1), increment)) return false;
+
+        timeControl.baseMs = (int64_t) (base * 1000);
+        timeControl.incrementMs = (int64_t) (increment * 1000);
+        return timeControl.baseMs > 0;
+    }
+
+    bool parseArguments(int argc, char* argv[], Arguments& args) {
+        std::vector<std::string_view> tokens(argv + 1, argv + argc);
+        auto isFlag = [](std::string_view token) { return token.starts_with("--"); };
+
+        for (size_t i = 0; i < tokens.size(); i++) {
+            std::string_view flag = tokens[i];
+            // values up to the next flag
+            std::vector<std::string_view> values;
+            while (i + 1 < tokens.size() && !isFlag(tokens[i + 1])) values.push_back(tokens[++i]);
+
+            bool ok = true;
+            if (flag == "--engine") {
+                EngineSpec engine;
+                for (std::string_view value : values) {
+                    size_t equals = value.find('=');
+                    if (equals == std::string_view::npos) return false;
+
+                    std::string key(value.substr(0, equals));
+                    std::string setting(value.substr(equals + 1));
+                    if (key == "cmd") engine.command = setting;
+                    else if (key == "name") engine.name = setting;
+                    else engine.options.emplace_back(key, setting);
+                }
+                args.engines.push_back(engine);
+            } else if (flag == "--games" && values.size() == 1) {
+                ok = parseInto(values[0], args.games) && args.games > 0;
+            } else if (flag == "--concurrency" && values.size() == 1) {
+                ok = parseInto(values[0], args.concurrency) && args.concurrency > 0;
+            } else if (flag == "--tc" && values.size() == 1) {
+                ok = parseTimeControl(values[0], args.timeControl);
+            } else if (flag == "--movetime" && values.size() == 1) {
+                ok = parseInto(values[0], args.timeControl.moveTimeMs) && args.timeControl.moveTimeMs > 0;
+            } else if (flag == "--depth" && values.size() == 1) {
+                ok = parseInto(values[0], args.timeControl.depth) && args.timeControl.depth > 0;
+            } else if (flag == "--nodes" && values.size() == 1) {
+                ok = parseInto(values[0], args.timeControl.nodes) && args.timeControl.nodes > 0;
+            } else if (flag == "--openings" && values.size() == 1) {
+                args.openings = values[0];
+            } else if (flag == "--random-plies" && values.size() == 1) {
+                ok = parseInto(values[0], args.randomPlies) && args.randomPlies >= 0;
+            } else if (flag == "--seed" && values.size() == 1) {
+                ok = parseInto(values[0], args.seed);
+            } else if (flag == "--sprt" && (values.size() == 2 || values.size() == 4)) {
+                Sprt sprt;
+                ok = parseInto(values[0], sprt.elo0) && parseInto(values[1], sprt.elo1) && sprt.elo0 < sprt.elo1;
+                if (values.size() == 4) ok = ok && parseInto(values[2], sprt.alpha) && parseInto(values[3], sprt.beta);
+                args.sprt = sprt;
+            } else if (flag == "--resign" && values.size() == 2) {
+                ok = parseInto(values[0], args.adjudication.resignMoves) && parseInto(values[1], args.adjudication.resignScore);
+            } else if (flag == "--draw" && values.size() == 3) {
+                ok = parseInto(values[0], args.adjudication.drawMoveNumber) && parseInto(values[1], args.adjudication.drawMoves)
+                     && parseInto(values[2], args.adjudication.drawScore);
+            } else if (flag == "--maxmoves" && values.size() == 1) {
+                ok = parseInto(values[0], args.adjudication.maxMoves) && args.adjudication.maxMoves > 0;
+            } else {
+                ok = false;
+            }
+
+            if (!ok) return false;
+        }
+
+        // both colors of every opening
+        args.games += args.games % 2;
+        return args.engines.size() == 2;
+    }
+
+    std::unique_ptr<Player> makePlayer(const EngineSpec& spec, int index) {
+        std::string name = spec.name.empty() && spec.command.empty() ? "engine" + std::to_string(index + 1) : spec.name;
+
+        if (!spec.command.empty()) {
+            auto player = std::make_unique<ProcessPlayer>();
+            if (!player->start(spec.command, spec.options, name)) {
+                std::cerr << "could not start " << spec.command << std::endl;
+                return nullptr;
+            }
+            return player;
+        }
+
+        auto player = std::make_unique<EnginePlayer>(name);
+        for (const auto& [option, value] : spec.options) {
+            if (!player->setOption(option, value)) {
+                std::cerr << "invalid option " << option << "=" << value << std::endl;
+                return nullptr;
+            }
+        }
+        return player;
+    }
+
+    // the positions of an EPD file as full FENs, which every engine accepts
+    std::vector<std::string> readOpenings(const std::string& path) {
+        std::vector<std::string> fens;
+        choco::epd::Reader reader;
+        if (!reader.open(path)) return fens;
+
+        choco::Board board;
+        choco::epd::Record record;
+        while (reader.next(record)) {
+            const char* error = nullptr;
+            if (!board.loadFen(record.fen, &error)) {
+                std::cerr << path << ":" << record.line << ": " << error << std::endl;
+                continue;
+            }
+            fens.push_back(choco::boardToFen(board));
+        }
+        return fens;
+    }
+
+    const char* resultString(Result result) {
+        switch (result) {
+            case Result::WHITE_WIN: return "1-0";
+            case Result::BLACK_WIN: return "0-1";
+            default:                return "1/2-1/2";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        printUsage();
+        return 1;
+    }
+
+    choco::initBitboards();
+    // in-process engines evaluate like johnner_uci
+    if (!choco::nnue::loadEmbedded()) {
+        choco::nnue::loadFile("johnner.nnue");
+    }
+
+    std::vector<std::string> openings;
+    if (!args.openings.empty()) {
+        openings = readOpenings(args.openings);
+        if (openings.empty()) {
+            std::cerr << "no positions in " << args.openings << std::endl;
+            return 1;
+        }
+    }
+
+    // a seat is one pair of players; each concurrent game takes a free one
+    std::vector<std::unique_ptr<Player>> seats[2];
+    for (int seat = 0; seat < args.concurrency; seat++) {
+        for (int engine = 0; engine < 2; engine++) {
+            std::unique_ptr<Player> player = makePlayer(args.engines[engine], engine);
+            if (!player) return 1;
+            seats[engine].push_back(std::move(player));
+        }
+    }
+
+    const std::string names[2] = { seats[0][0]->name(), seats[1][0]->name() };
+
+    std::mutex mutex;
+    std::vector<int> freeSeats;
+    for (int seat = 0; seat < args.concurrency; seat++) freeSeats.push_back(seat);
+
+    Score score;
+    int finished = 0;
+    std::atomic<bool> decided = false;
+
+    choco::ThreadPool pool((size_t) args.concurrency);
+    std::vector<std::future<void>> results;
+
+    for (int gameIndex = 0; gameIndex < args.games; gameIndex++) {
+        results.push_back(pool.submit([&, gameIndex]() {
+            if (decided) return;
+
+            int pair = gameIndex / 2;
+            std::string fen = openings.empty() ? randomOpening(args.randomPlies, args.seed + pair)
+                                               : openings[pair % openings.size()];
+
+            int seat;
+            {
+                std::lock_guard lock(mutex);
+                seat = freeSeats.back();
+                freeSeats.pop_back();
+            }
+
+            // the second game of a pair swaps colors
+            int whiteEngine = gameIndex % 2;
+            Player& white = *seats[whiteEngine][seat];
+            Player& black = *seats[1 - whiteEngine][seat];
+            Game game = playGame(white, black, fen, args.timeControl, args.adjudication);
+
+            std::lock_guard lock(mutex);
+            freeSeats.push_back(seat);
+
+            bool draw = game.result == Result::DRAW;
+            bool whiteWon = game.result == Result::WHITE_WIN;
+            if (draw) score.draws++;
+            else if (whiteWon == (whiteEngine == 0)) score.wins++;
+            else score.losses++;
+            finished++;
+
+            auto [elo, margin] = score.elo();
+            std::printf("Finished game %d (%s vs %s): %s {%s}\n", gameIndex + 1, white.name().c_str(),
+                        black.name().c_str(), resultString(game.result), game.reason.c_str());
+            std::printf("Score of %s vs %s: %llu - %llu - %llu  [%.3f] %d\n", names[0].c_str(), names[1].c_str(),
+                        (unsigned long long) score.wins, (unsigned long long) score.losses,
+                        (unsigned long long) score.draws, score.ratio(), finished);
+            std::printf("Elo difference: %.1f +/- %.1f\n", elo, margin);
+
+            if (args.sprt && !decided) {
+                double llr = args.sprt->llr(score);
+                std::printf("LLR: %.2f (%.2f, %.2f) [%.2f, %.2f]\n", llr, args.sprt->lowerBound(),
+                            args.sprt->upperBound(), args.sprt->elo0, args.sprt->elo1);
+
+                if (llr >= args.sprt->upperBound() || llr <= args.sprt->lowerBound()) {
+                    decided = true;
+                    std::printf("SPRT: H%d accepted\n", llr >= args.sprt->upperBound() ? 1 : 0);
+                }
+            }
+            std::fflush(stdout);
+        }));
+    }
+
+    for (auto& result : results) result.get();
+    return 0;
+}
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bithelpers.h"
+#include "board.h"
+#include "mapped_file.h"
+#include "packed_position.h"
+#include "pgn.h"
+#include "str_util.h"
+#include "thread_pool.h"
+
+namespace {
+    using namespace choco;
+
+    void printUsage() {
+        std::cerr << "usage: johnner_pgn <file.pgn> [--out FILE] [--format epd|bin] [--positions all|quiet]\n"
+                  << "                   [--min-ply N] [--threads N]\n"
+                  << "writes the main-line positions of every game as EPD (with id, sm, ce and c9 operations)\n"
+                  << "or as 32-byte johnner_datagen records; quiet keeps positions not in check whose move is\n"
+                  << "not a capture or promotion. Records of moves without a score comment are flagged NO_SCORE"
+                  << std::endl;
+    }
+
+    // the file is cut into pieces of about this size, handed to the threads in order
+    constexpr size_t CHUNK_BYTES = 1 << 22;
+    // finished pieces that may wait for an earlier, slower one before they are written, per thread
+    constexpr size_t PENDING_PER_THREAD = 4;
+    // scores beyond this are mates or tablebase wins, which say nothing about the eval
+    constexpr int MAX_RECORDED_SCORE = 10000;
+
+    struct Arguments {
+        std::string input;
+        std::string out;
+        bool binary = false;
+        bool quiet = false;
+        size_t minPly = 0;
+        size_t threads = 0;
+    };
+
+    template<typename T>
+    bool parseInto(std::string_view text, T& target) {
+        std::optional<T> value = util::parseNumber<T>(text);
+        if (value) target = *value;
+        return value.has_value();
+    }
+
+    bool parseArguments(int argc, char* argv[], Arguments& args) {
+        for (int i = 1; i < argc; i++) {
+            std::string_view flag = argv[i];
+            if (!flag.starts_with("--")) {
+                if (!args.input.empty()) return false;
+                args.input = flag;
+                continue;
+            }
+            if (i + 1 >= argc) return false;
+            std::string_view value = argv[++i];
+
+            bool ok = true;
+            if (flag == "--out") {
+                args.out = value;
+            } else if (flag == "--format") {
+                ok = value == "epd" || value == "bin";
+                args.binary = value == "bin";
+            } else if (flag == "--positions") {
+                ok = value == "all" || value == "quiet";
+                args.quiet = value == "quiet";
+            } else if (flag == "--min-ply") {
+                ok = parseInto(value, args.minPly);
+            } else if (flag == "--threads") {
+                ok = parseInto(value, args.threads) && args.threads > 0;
+            } else {
+                ok = false;
+            }
+
+            if (!ok) return false;
+        }
+        return !args.input.empty();
+    }
+
+    // the engine score in a move's comment, in centipawns for the side that played it: cutechess
+    // writes {+0.31/14 0.52s} from the mover's side, lichess [%eval 0.31] from white's. Mates and
+    // comments without a score give nullopt
+    std::optional<int> commentScore(std::string_view comment, uint8_t us) {
+        size_t eval = comment.find("[%eval ");
+        if (eval != std::string_view::npos) {
+            std::string_view rest = comment.substr(eval + 7);
+            std::optional<double> pawns = util::parseNumber<double>(rest.substr(0, rest.find_first_of("] ")));
+            if (!pawns) return std::nullopt;
+            int score = (int) std::lround(*pawns * 100);
+            return us == SIDE_WHITE ? score : -score;
+        }
+
+        std::string_view token = util::nextToken(comment);
+        size_t slash = token.find('/');
+        if (slash == std::string_view::npos) return std::nullopt;
+        std::string_view value = token.substr(0, slash);
+        if (value.starts_with('+')) value.remove_prefix(1);
+        std::optional<double> pawns = util::parseNumber<double>(value);
+        if (!pawns) return std::nullopt;
+        return (int) std::lround(*pawns * 100);
+    }
+
+    // turns the games of one piece of the file into EPD lines or packed records
+    class Extractor : public pgn::Visitor {
+    public:
+        Extractor(const Arguments& args, const char* fileStart) : args(args), fileStart(fileStart) { }
+
+        bool startGame(const pgn::Game& game) override {
+            games++;
+            result = game.result == "1-0" ? PackedPosition::RESULT_WHITE_WIN
+                   : game.result == "0-1" ? PackedPosition::RESULT_BLACK_WIN
+                   : PackedPosition::RESULT_DRAW;
+            // records need a result
+            if (args.binary && game.result != "1-0" && game.result != "0-1" && game.result != "1/2-1/2") {
+                skipped++;
+                return false;
+            }
+            return true;
+        }
+
+        void position(const pgn::Game& game, const Board& board, const Move& move, std::string_view comment) override {
+            if (game.plies < args.minPly) return;
+
+            uint8_t us = board.state.activeColor;
+            if (args.quiet) {
+                bool inCheck = board.bitboards[us][KING] & board.getAttacks(oppositeSide(us));
+                bool capture = (board.occupiedSquares[oppositeSide(us)] & getMask(move.to))
+                               || (move.pieceType == PAWN && move.to == board.state.enpassantSquare);
+                if (inCheck || capture || isValidPiece(move.promotionType)) return;
+            }
+
+            std::optional<int> score = commentScore(comment, us);
+            if (args.binary) {
+                if (score && std::abs(*score) > MAX_RECORDED_SCORE) return;
+                PackedPosition packed = packPosition(board, (int16_t) score.value_or(0), result);
+                if (!score) packed.flags |= PackedPosition::NO_SCORE;
+                output.append(reinterpret_cast<const char*>(&packed), sizeof(packed));
+            } else {
+                // the id is the byte offset of the game in the file and the ply
+                output += boardToFen(board);
+                output += " id \"" + std::to_string(game.text.data() - fileStart) + ":" + std::to_string(game.plies) + "\";";
+                output += " sm " + pgn::moveToSan(board, move) + ";";
+                if (score) output += " ce " + std::to_string(*score) + ";";
+                if (game.result != "*") output += " c9 \"" + std::string(game.result) + "\";";
+                output += '\n';
+            }
+            positions++;
+        }
+
+        void endGame(const pgn::Game& game, const Board&) override {
+            if (!game.error) return;
+            errors += "game at byte " + std::to_string(game.text.data() - fileStart) + ": " + game.error
+                      + " after " + std::to_string(game.plies) + " plies\n";
+        }
+
+        std::string output;
+        std::string errors;
+        uint64_t games = 0;
+        uint64_t skipped = 0;
+        uint64_t positions = 0;
+    private:
+        const Arguments& args;
+        const char* fileStart;
+        uint8_t result = PackedPosition::RESULT_DRAW;
+    };
+}
+
+int main(int argc, char* argv[]) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+
+    MappedFile file;
+    if (!file.open(args.input)) {
+        std::cerr << "cannot open " << args.input << std::endl;
+        return 1;
+    }
+
+    std::FILE* out = args.out.empty() ? stdout : std::fopen(args.out.c_str(), args.binary ? "wb" : "w");
+    if (!out) {
+        std::cerr << "cannot open " << args.out << std::endl;
+        return 1;
+    }
+
+    ThreadPool pool(args.threads);
+    const std::string_view text = file.view();
+    const std::vector<std::string_view> chunks = pgn::splitGames(text, std::max(pool.size(), text.size() / CHUNK_BYTES + 1));
+    const size_t window = PENDING_PER_THREAD * pool.size();
+
+    // pieces are handed out in file order and written in file order, so the output doesn't
+    // depend on the number of threads
+    std::mutex mutex;
+    std::condition_variable written;
+    size_t nextIndex = 0;
+    size_t nextToWrite = 0;
+    std::map<size_t, Extractor> pending;
+    uint64_t games = 0;
+    uint64_t skipped = 0;
+    uint64_t positions = 0;
+    bool failed = false;
+
+    std::vector<std::future<void>> workers;
+    for (size_t worker = 0; worker < pool.size(); worker++) {
+        workers.push_back(pool.submit([&]() {
+            while (true) {
+                size_t index;
+                {
+                    std::unique_lock lock(mutex);
+                    written.wait(lock, [&]() { return nextIndex < nextToWrite + window; });
+                    if (nextIndex >= chunks.size()) return;
+                    index = nextIndex++;
+                }
+
+                Extractor extractor(args, text.data());
+                pgn::forEachGame(chunks[index], extractor);
+
+                std::lock_guard lock(mutex);
+                pending.emplace(index, std::move(extractor));
+                while (!pending.empty() && pending.begin()->first == nextToWrite) {
+                    const Extractor& done = pending.begin()->second;
+                    failed |= std::fwrite(done.output.data(), 1, done.output.size(), out) != done.output.size();
+                    std::cerr << done.errors;
+                    games += done.games;
+                    skipped += done.skipped;
+                    positions += done.positions;
+                    pending.erase(pending.begin());
+                    nextToWrite++;
+                }
+                written.notify_all();
+            }
+        }));
+    }
+
+    for (auto& worker : workers) worker.get();
+    if (out != stdout) failed |= std::fclose(out) != 0;
+    else failed |= std::fflush(out) != 0;
+
+    std::cerr << games << " games, " << positions << " positions";
+    if (skipped > 0) std::cerr << ", " << skipped << " games without a result skipped";
+    std::cerr << std::endl;
+
+    if (failed) {
+        std::cerr << "could not write " << (args.out.empty() ? "the output" : args.out) << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,10 +3,16 @@
 #include "uci.h"
 #include "board.h"
 #include "search.h"
+#include "nnue.h"
+#include "str_util.h"
 
 int main() {
     choco::initBitboards();
-    choco::initTT();
+
+    // an embedded network wins over one sitting next to the binary; with neither, the PST eval is used
+    if (!choco::nnue::loadEmbedded()) {
+        choco::nnue::loadFile("johnner.nnue");
+    }
 
     choco::UciInstance inst{};
 
@@ -19,5 +25,7 @@ int main() {
         }
 
         inst.processLine(input);
+
+        if (choco::util::trim(input) == "quit") break;
     }
 }
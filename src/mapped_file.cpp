@@ -0,0 +1,112 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace choco {
+    MappedFile::MappedFile(const std::string& path) {
+        open(path);
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            bytes = std::exchange(other.bytes, nullptr);
+            length = std::exchange(other.length, 0);
+#ifdef _WIN32
+            mapping = std::exchange(other.mapping, nullptr);
+#endif
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::open(const std::string& path) {
+        close();
+
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        // the mapping keeps its own reference to the file
+        HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!map) return false;
+
+        void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(map);
+            return false;
+        }
+
+        bytes = static_cast<const uint8_t*>(view);
+        length = (size_t) fileSize.QuadPart;
+        mapping = map;
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (!bytes) return;
+
+        UnmapViewOfFile(bytes);
+        CloseHandle(mapping);
+        bytes = nullptr;
+        length = 0;
+        mapping = nullptr;
+    }
+#else
+    bool MappedFile::open(const std::string& path) {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        // the mapping stays valid after the descriptor is closed
+        void* view = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) return false;
+
+        bytes = static_cast<const uint8_t*>(view);
+        length = (size_t) info.st_size;
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (!bytes) return;
+
+        munmap(const_cast<uint8_t*>(bytes), length);
+        bytes = nullptr;
+        length = 0;
+    }
+#endif
+} // namespace choco
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace choco {
+    // Read-only memory mapping of a whole file. Pages are loaded by the OS on first touch and shared
+    // between processes mapping the same file, so large books, tables and databases cost no copies.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const std::string& path);
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        ~MappedFile();
+
+        // unmaps any previous file; false if the file can't be opened or mapped
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const {
+            return bytes != nullptr;
+        }
+
+        const uint8_t* data() const {
+            return bytes;
+        }
+        size_t size() const {
+            return length;
+        }
+        std::string_view view() const {
+            return { reinterpret_cast<const char*>(bytes), length };
+        }
+    private:
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        void* mapping = nullptr;
+#endif
+    };
+} // namespace choco
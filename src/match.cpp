@@ -0,0 +1,317 @@
+#include "match.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "bithelpers.h"
+#include "str_util.h"
+
+namespace choco::match {
+    namespace {
+        // centipawn score reported for mates and tablebase wins
+        constexpr int MATE_SCORE = 100000;
+        // how long an external engine may stay silent beyond its own time before it forfeits
+        constexpr int64_t REPLY_GRACE_MS = 5000;
+        constexpr int64_t HANDSHAKE_MS = 10000;
+
+        int64_t elapsedMs(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // no pawns, rooks or queens, and at most one minor piece on the board
+        bool insufficientMaterial(const Board& board) {
+            uint64_t minors = 0;
+            for (uint8_t side = 0; side < 2; side++) {
+                if (board.bitboards[side][PAWN] | board.bitboards[side][ROOK] | board.bitboards[side][QUEEN]) return false;
+                minors |= board.bitboards[side][BISHOP] | board.bitboards[side][KNIGHT];
+            }
+            return countOnes(minors) <= 1;
+        }
+
+        std::string positionCommand(const std::string& fen, const std::vector<std::string>& moves) {
+            std::string command = "position fen " + fen;
+            if (!moves.empty()) command += " moves";
+            for (const std::string& move : moves) command += " " + move;
+            return command;
+        }
+
+        double eloFromRatio(double ratio) {
+            ratio = std::clamp(ratio, 1e-6, 1 - 1e-6);
+            return -400 * std::log10(1 / ratio - 1);
+        }
+
+        double ratioFromElo(double elo) {
+            return 1 / (1 + std::pow(10, -elo / 400));
+        }
+
+        // variance of a single game's score around the mean
+        double variance(const Score& score) {
+            double n = (double) score.games();
+            double ratio = score.ratio();
+            return (score.wins * (1 - ratio) * (1 - ratio) + score.draws * (0.5 - ratio) * (0.5 - ratio)
+                    + score.losses * ratio * ratio) / n;
+        }
+    }
+
+    EnginePlayer::EnginePlayer(std::string name) : playerName(std::move(name)), search(Board()) {
+        search.options.uciOutput = false;
+        addSearchOptions(options, search);
+        // games run side by side, so the default hash would be wasteful
+        options.set("Hash", "16");
+    }
+
+    bool EnginePlayer::setOption(const std::string& option, const std::string& value) {
+        return options.set(option, value) == UciOptions::SetResult::OK;
+    }
+
+    void EnginePlayer::newGame() {
+        search.clearTT();
+    }
+
+    std::optional<Reply> EnginePlayer::think(const std::string& fen, const std::vector<std::string>& moves,
+                                             const GoLimits& limits) {
+        search.setBoard<false>(Board(fen));
+        for (const std::string& move : moves) search.playMove(uciToMove(search.getBoard(), move));
+
+        uint8_t us = search.getBoard().state.activeColor;
+
+        SearchBounds bounds = {};
+        if (limits.moveTime > 0) {
+            bounds.moveTime = limits.moveTime;
+        } else if (limits.time[us] >= 0) {
+            bounds.moveTime = std::max<int64_t>(moveTimeBudget(limits.time[us], limits.increment[us], 0), 1);
+        } else {
+            bounds.moveTime = std::numeric_limits<int32_t>::max();
+        }
+        bounds.depth = limits.depth;
+        bounds.nodes = limits.nodes;
+
+        search.search(bounds);
+
+        Move best = search.getBestMove();
+        if (!isValidPiece(best.pieceType)) return std::nullopt;
+
+        int score = (int) std::clamp<float>(std::round(search.getEval() * 100), -MATE_SCORE, MATE_SCORE);
+        return Reply{ moveToUci(best), score };
+    }
+
+    bool ProcessPlayer::start(const std::string& command, const std::vector<std::pair<std::string, std::string>>& options,
+                              std::string name) {
+        playerName = std::move(name);
+        if (!process.start(command) || !process.send("uci")) return false;
+
+        while (true) {
+            std::optional<std::string> line = process.readLine(HANDSHAKE_MS);
+            if (!line) return false;
+
+            std::string_view rest = *line;
+            std::string_view token = util::nextToken(rest);
+            if (token == "uciok") break;
+            if (token == "id" && util::nextToken(rest) == "name" && playerName.empty()) playerName = util::trim(rest);
+        }
+
+        for (const auto& [option, value] : options) process.send("setoption name " + option + " value " + value);
+        process.send("isready");
+        return waitFor("readyok", HANDSHAKE_MS);
+    }
+
+    bool ProcessPlayer::waitFor(std::string_view token, int64_t timeoutMs) {
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            std::optional<std::string> line = process.readLine(std::max<int64_t>(timeoutMs - elapsedMs(start), 0));
+            if (!line) return false;
+            if (util::trim(*line) == token) return true;
+        }
+    }
+
+    void ProcessPlayer::newGame() {
+        process.send("ucinewgame");
+        process.send("isready");
+        waitFor("readyok", HANDSHAKE_MS);
+    }
+
+    std::optional<Reply> ProcessPlayer::think(const std::string& fen, const std::vector<std::string>& moves,
+                                              const GoLimits& limits) {
+        std::string go = "go";
+        int64_t timeoutMs = 10 * 60 * 1000;
+
+        if (limits.moveTime > 0) {
+            go += " movetime " + std::to_string(limits.moveTime);
+            timeoutMs = limits.moveTime;
+        } else if (limits.time[SIDE_WHITE] >= 0) {
+            go += " wtime " + std::to_string(limits.time[SIDE_WHITE]) + " btime " + std::to_string(limits.time[SIDE_BLACK])
+                  + " winc " + std::to_string(limits.increment[SIDE_WHITE]) + " binc " + std::to_string(limits.increment[SIDE_BLACK]);
+            timeoutMs = std::max(limits.time[SIDE_WHITE], limits.time[SIDE_BLACK]);
+        }
+        if (limits.depth > 0) go += " depth " + std::to_string(limits.depth);
+        if (limits.nodes > 0) go += " nodes " + std::to_string(limits.nodes);
+
+        process.send(positionCommand(fen, moves));
+        process.send(go);
+
+        auto start = std::chrono::steady_clock::now();
+        Reply reply;
+        while (true) {
+            std::optional<std::string> line = process.readLine(std::max<int64_t>(timeoutMs + REPLY_GRACE_MS - elapsedMs(start), 0));
+            if (!line) return std::nullopt;
+
+            std::string_view rest = *line;
+            std::string_view token = util::nextToken(rest);
+
+            if (token == "bestmove") {
+                reply.move = util::nextToken(rest);
+                return reply;
+            }
+            if (token != "info") continue;
+
+            // the last score of the search is the one that counts
+            for (token = util::nextToken(rest); !token.empty(); token = util::nextToken(rest)) {
+                if (token != "score") continue;
+
+                std::string_view type = util::nextToken(rest);
+                int value = util::parseNumber<int>(util::nextToken(rest)).value_or(0);
+                if (type == "cp") reply.score = std::clamp(value, -MATE_SCORE, MATE_SCORE);
+                if (type == "mate") reply.score = value > 0 ? MATE_SCORE : -MATE_SCORE;
+            }
+        }
+    }
+
+    Game playGame(Player& white, Player& black, const std::string& fen, const TimeControl& timeControl,
+                  const Adjudication& adjudication) {
+        Player* players[2] = { &white, &black };
+        white.newGame();
+        black.newGame();
+
+        Game game;
+        game.fen = fen;
+
+        Board board(fen);
+        std::vector<uint64_t> keys = { board.key };
+
+        const bool clocked = timeControl.moveTimeMs <= 0 && timeControl.depth <= 0 && timeControl.nodes == 0;
+        int64_t clock[2] = { timeControl.baseMs, timeControl.baseMs };
+        int resignCount[2] = {};
+        int drawCount = 0;
+
+        auto finish = [&game](Result result, std::string reason) {
+            game.result = result;
+            game.reason = std::move(reason);
+            return game;
+        };
+        auto loses = [](uint8_t side) {
+            return side == SIDE_WHITE ? Result::BLACK_WIN : Result::WHITE_WIN;
+        };
+
+        while (true) {
+            uint8_t us = board.state.activeColor;
+            const char* side = us == SIDE_WHITE ? "White" : "Black";
+
+            MoveList legal = board.generateLegalMoves();
+            if (legal.size() == 0) {
+                bool inCheck = board.bitboards[us][KING] & board.getAttacks(oppositeSide(us));
+                return inCheck ? finish(loses(us), std::string(side) + " is mated") : finish(Result::DRAW, "stalemate");
+            }
+            if (board.state.halfMoveClock >= 100) return finish(Result::DRAW, "fifty-move rule");
+            if (std::count(keys.begin(), keys.end(), board.key) >= 3) return finish(Result::DRAW, "threefold repetition");
+            if (insufficientMaterial(board)) return finish(Result::DRAW, "insufficient material");
+            if ((int) game.moves.size() >= 2 * adjudication.maxMoves) return finish(Result::DRAW, "move limit");
+
+            GoLimits limits;
+            limits.moveTime = timeControl.moveTimeMs;
+            limits.depth = timeControl.depth;
+            limits.nodes = timeControl.nodes;
+            if (clocked) {
+                for (uint8_t s = 0; s < 2; s++) {
+                    limits.time[s] = std::max<int64_t>(clock[s], 1);
+                    limits.increment[s] = timeControl.incrementMs;
+                }
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            std::optional<Reply> reply = players[us]->think(fen, game.moves, limits);
+            int64_t elapsed = elapsedMs(start);
+
+            if (!reply) return finish(loses(us), std::string(side) + " did not reply");
+
+            if (clocked) {
+                clock[us] -= elapsed;
+                if (clock[us] < -timeControl.marginMs) return finish(loses(us), std::string(side) + " loses on time");
+                clock[us] += timeControl.incrementMs;
+            }
+
+            std::optional<Move> move;
+            for (const Move& m : legal) {
+                if (moveToUci(m) == reply->move) move = m;
+            }
+            if (!move) return finish(loses(us), std::string(side) + " played an illegal move " + reply->move);
+
+            board.makeMove(*move);
+            keys.push_back(board.key);
+            game.moves.push_back(reply->move);
+            game.scores.push_back(reply->score);
+
+            resignCount[us] = reply->score <= -adjudication.resignScore ? resignCount[us] + 1 : 0;
+            if (adjudication.resignMoves > 0 && resignCount[us] >= adjudication.resignMoves) {
+                return finish(loses(us), std::string(side) + " resigns");
+            }
+
+            int moveNumber = (int) game.moves.size() / 2 + 1;
+            drawCount = (moveNumber >= adjudication.drawMoveNumber && std::abs(reply->score) <= adjudication.drawScore)
+                        ? drawCount + 1 : 0;
+            if (adjudication.drawMoves > 0 && drawCount >= 2 * adjudication.drawMoves) {
+                return finish(Result::DRAW, "draw by adjudication");
+            }
+        }
+    }
+
+    std::string randomOpening(int plies, uint64_t seed) {
+        std::mt19937_64 rng(seed);
+
+        while (true) {
+            Board board(STARTING_POS);
+
+            for (int ply = 0; ply < plies; ply++) {
+                MoveList legal = board.generateLegalMoves();
+                if (legal.size() == 0) break;
+                board.makeMove(legal[rng() % legal.size()]);
+            }
+
+            // a line that already ended the game gets another try
+            if (board.generateLegalMoves().size() > 0) return boardToFen(board);
+        }
+    }
+
+    double Score::ratio() const {
+        return games() == 0 ? 0.5 : (wins + draws * 0.5) / games();
+    }
+
+    std::pair<double, double> Score::elo() const {
+        if (games() == 0) return { 0, 0 };
+
+        double margin = 1.959964 * std::sqrt(variance(*this) / games());
+        double ratio = this->ratio();
+        return { eloFromRatio(ratio), (eloFromRatio(ratio + margin) - eloFromRatio(ratio - margin)) / 2 };
+    }
+
+    double Sprt::llr(const Score& score) const {
+        if (score.games() == 0) return 0;
+
+        double var = variance(score);
+        if (var <= 0) return 0;
+
+        double ratio0 = ratioFromElo(elo0);
+        double ratio1 = ratioFromElo(elo1);
+        return (ratio1 - ratio0) * (2 * score.ratio() - ratio0 - ratio1) / (2 * var / score.games());
+    }
+
+    double Sprt::lowerBound() const {
+        return std::log(beta / (1 - alpha));
+    }
+
+    double Sprt::upperBound() const {
+        return std::log((1 - beta) / alpha);
+    }
+} // namespace choco::match
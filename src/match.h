@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "search.h"
+#include "uci.h"
+#include "uci_process.h"
+
+// Engine-vs-engine games for johnner_match: players, one game with adjudication, and the SPRT
+// that decides when a match has seen enough games.
+namespace choco::match {
+    struct TimeControl {
+        int64_t baseMs = 10000;
+        int64_t incrementMs = 100;
+        int64_t moveTimeMs = 0; // fixed time per move instead of a clock
+        int depth = 0;          // fixed depth instead of a clock
+        uint64_t nodes = 0;     // fixed nodes instead of a clock
+        int64_t marginMs = 100; // overrun allowed before a flag falls
+    };
+
+    struct Adjudication {
+        // a side resigns once its own score has been at most -resignScore for resignMoves moves
+        int resignMoves = 3;
+        int resignScore = 1000; // centipawns
+        // a draw is declared from drawMoveNumber on, once both scores stayed within drawScore for drawMoves moves each
+        int drawMoveNumber = 40;
+        int drawMoves = 8;
+        int drawScore = 10;
+        int maxMoves = 300;     // full moves before the game is drawn
+    };
+
+    // what a player is told for each move
+    struct GoLimits {
+        int64_t time[2] = { -1, -1 };
+        int64_t increment[2] = { 0, 0 };
+        int64_t moveTime = -1;
+        int depth = 0;
+        uint64_t nodes = 0;
+    };
+
+    struct Reply {
+        std::string move; // UCI
+        int score = 0;    // centipawns from the mover's point of view; mates are +-100000
+    };
+
+    class Player {
+    public:
+        virtual ~Player() = default;
+
+        virtual const std::string& name() const = 0;
+        virtual void newGame() = 0;
+        // nothing when the player failed to answer
+        virtual std::optional<Reply> think(const std::string& fen, const std::vector<std::string>& moves,
+                                           const GoLimits& limits) = 0;
+    };
+
+    // a Search in this process, configured with the engine's UCI options
+    class EnginePlayer : public Player {
+    public:
+        explicit EnginePlayer(std::string name);
+
+        // false if the option doesn't exist or the value is out of range
+        bool setOption(const std::string& option, const std::string& value);
+
+        const std::string& name() const override {
+            return playerName;
+        }
+        void newGame() override;
+        std::optional<Reply> think(const std::string& fen, const std::vector<std::string>& moves,
+                                   const GoLimits& limits) override;
+    private:
+        std::string playerName;
+        Search search;
+        UciOptions options;
+    };
+
+    // a UCI engine in another process
+    class ProcessPlayer : public Player {
+    public:
+        // false if the engine doesn't start or complete the UCI handshake
+        bool start(const std::string& command, const std::vector<std::pair<std::string, std::string>>& options,
+                   std::string name);
+
+        const std::string& name() const override {
+            return playerName;
+        }
+        void newGame() override;
+        std::optional<Reply> think(const std::string& fen, const std::vector<std::string>& moves,
+                                   const GoLimits& limits) override;
+    private:
+        bool waitFor(std::string_view token, int64_t timeoutMs);
+
+        std::string playerName;
+        UciProcess process;
+    };
+
+    enum class Result {
+        WHITE_WIN, BLACK_WIN, DRAW
+    };
+
+    struct Game {
+        std::string fen;
+        std::vector<std::string> moves;
+        std::vector<int> scores; // each move's reported score, from the mover's point of view
+        Result result = Result::DRAW;
+        std::string reason;
+    };
+
+    Game playGame(Player& white, Player& black, const std::string& fen, const TimeControl& timeControl,
+                  const Adjudication& adjudication);
+
+    // the start position after plies random legal moves; the same seed gives the same opening
+    std::string randomOpening(int plies, uint64_t seed);
+
+    // wins, draws and losses of the first engine
+    struct Score {
+        uint64_t wins = 0;
+        uint64_t draws = 0;
+        uint64_t losses = 0;
+
+        uint64_t games() const {
+            return wins + draws + losses;
+        }
+        double ratio() const;
+        // Elo difference and the half width of its 95% confidence interval
+        std::pair<double, double> elo() const;
+    };
+
+    // sequential probability ratio test of H0: elo = elo0 against H1: elo = elo1, using the
+    // normal approximation of the log-likelihood ratio on the game results
+    struct Sprt {
+        double elo0 = 0;
+        double elo1 = 5;
+        double alpha = 0.05;
+        double beta = 0.05;
+
+        double llr(const Score& score) const;
+        double lowerBound() const;
+        double upperBound() const;
+    };
+} // namespace choco::match
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "bithelpers.h"
+#include "eval.h"
+#include "macros.h"
+#include "pawns.h"
+#include "str_util.h"
+
+// Times core primitives over the bench positions. Every benchmark runs for a warmup period,
+// then the fastest batch size that takes at least MIN_SAMPLE_NS is repeated; the median and median
+// absolute deviation of ns/op over the repetitions are reported.
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int64_t WARMUP_NS = 50'000'000;
+    constexpr int64_t MIN_SAMPLE_NS = 10'000'000;
+
+    // keeps results observable so the compiler can't drop the work being timed
+    volatile uint64_t sink;
+
+    struct Benchmark {
+        std::string name;
+        // runs one pass over the corpus and returns the number of operations performed
+        std::function<uint64_t()> pass;
+    };
+
+    struct Result {
+        std::string name;
+        double median;
+        double mad;
+        int samples;
+        uint64_t opsPerSample;
+    };
+
+    int64_t elapsedNs(Clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    }
+
+    double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        size_t mid = values.size() / 2;
+        return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+    }
+
+    Result run(const Benchmark& bench, int repetitions) {
+        // warmup, which also sizes a sample
+        uint64_t passesPerSample = 0;
+        Clock::time_point start = Clock::now();
+        while (elapsedNs(start) < WARMUP_NS) {
+            bench.pass();
+            passesPerSample++;
+        }
+        passesPerSample = std::max<uint64_t>(1, passesPerSample * MIN_SAMPLE_NS / WARMUP_NS);
+
+        std::vector<double> nsPerOp;
+        uint64_t ops = 0;
+        for (int rep = 0; rep < repetitions; rep++) {
+            ops = 0;
+            start = Clock::now();
+            for (uint64_t i = 0; i < passesPerSample; i++) ops += bench.pass();
+            nsPerOp.push_back((double) elapsedNs(start) / ops);
+        }
+
+        double med = median(nsPerOp);
+        std::vector<double> deviations;
+        for (double value : nsPerOp) deviations.push_back(std::abs(value - med));
+
+        return { bench.name, med, median(deviations), repetitions, ops };
+    }
+
+    std::vector<Benchmark> makeBenchmarks(std::vector<choco::Board>& boards) {
+        std::vector<Benchmark> benches;
+
+        benches.push_back({ "generatePLMoves", [&boards]() -> uint64_t {
+            for (const choco::Board& board : boards) sink = sink + board.generatePLMoves().size();
+            return boards.size();
+        }});
+
+        benches.push_back({ "generateLegalMoves", [&boards]() -> uint64_t {
+            for (const choco::Board& board : boards) sink = sink + board.generateLegalMoves().size();
+            return boards.size();
+        }});
+
+        benches.push_back({ "makeUnmake", [&boards]() -> uint64_t {
+            uint64_t ops = 0;
+            for (choco::Board& board : boards) {
+                for (const choco::Move& move : board.generatePLMoves()) {
+                    choco::UnmakeMove unmake = board.makeMove(move);
+                    if (unmake.isValid()) board.unmakeMove(unmake);
+                    ops++;
+                }
+            }
+            return ops;
+        }});
+
+        benches.push_back({ "getAttacks", [&boards]() -> uint64_t {
+            for (const choco::Board& board : boards) {
+                sink = sink + board.getAttacks(SIDE_WHITE) + board.getAttacks(SIDE_BLACK);
+            }
+            return boards.size() * 2;
+        }});
+
+        benches.push_back({ "sliderLookups", [&boards]() -> uint64_t {
+            for (const choco::Board& board : boards) {
+                for (uint8_t square = 0; square < 64; square++) {
+                    sink = sink + board.plRookMoveBB(square, SIDE_WHITE) + board.plBishopMoveBB(square, SIDE_WHITE);
+                }
+            }
+            return boards.size() * 64 * 2;
+        }});
+
+        benches.push_back({ "getHash", [&boards]() -> uint64_t {
+            for (const choco::Board& board : boards) sink = sink + choco::getHash(board);
+            return boards.size();
+        }});
+
+        // a fresh pawn table per pass would measure allocation, so the pawn terms are cached after
+        // the first pass; this times the per-node evaluation cost seen in search
+        static choco::PawnTable pawnTable;
+        benches.push_back({ "evaluate", [&boards]() -> uint64_t {
+            float total = 0;
+            for (const choco::Board& board : boards) total += choco::evaluateUncached(board, pawnTable);
+            sink = sink + (uint64_t) std::abs(total);
+            return boards.size();
+        }});
+
+        benches.push_back({ "parseFen", []() -> uint64_t {
+            for (const char* fen : BENCH_POSITIONS) sink = sink + choco::Board(fen).key;
+            return std::size(BENCH_POSITIONS);
+        }});
+
+        return benches;
+    }
+
+    void printUsage() {
+        std::cerr << "usage: johnner_microbench [--reps N] [--filter substring] [--format text|json|csv]" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = 15;
+    std::string_view filter;
+    std::string_view format = "text";
+
+    for (int i = 1; i < argc; i += 2) {
+        std::string_view flag = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        std::string_view value = argv[i + 1];
+
+        if (flag == "--reps") {
+            repetitions = choco::util::parseNumber<int>(value).value_or(0);
+        } else if (flag == "--filter") {
+            filter = value;
+        } else if (flag == "--format") {
+            format = value;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (repetitions < 1 || (format != "text" && format != "json" && format != "csv")) {
+        printUsage();
+        return 1;
+    }
+
+    choco::initBitboards();
+
+    std::vector<choco::Board> boards;
+    for (const char* fen : BENCH_POSITIONS) boards.emplace_back(fen);
+
+    if (format == "text") {
+        std::printf("%-20s %12s %10s %8s\n", "benchmark", "ns/op", "mad", "mad %");
+    } else if (format == "csv") {
+        std::printf("name,ns_per_op,mad,samples,ops_per_sample\n");
+    }
+
+    for (const Benchmark& bench : makeBenchmarks(boards)) {
+        if (!filter.empty() && bench.name.find(filter) == std::string::npos) continue;
+
+        Result r = run(bench, repetitions);
+
+        if (format == "text") {
+            std::printf("%-20s %12.2f %10.2f %7.1f%%\n", r.name.c_str(), r.median, r.mad, 100 * r.mad / r.median);
+        } else if (format == "csv") {
+            std::printf("%s,%.3f,%.3f,%d,%llu\n", r.name.c_str(), r.median, r.mad, r.samples,
+                        (unsigned long long) r.opsPerSample);
+        } else {
+            // one JSON object per line
+            std::printf("{\"name\":\"%s\",\"ns_per_op\":%.3f,\"mad\":%.3f,\"samples\":%d,\"ops_per_sample\":%llu}\n",
+                        r.name.c_str(), r.median, r.mad, r.samples, (unsigned long long) r.opsPerSample);
+        }
+        std::fflush(stdout);
+    }
+}
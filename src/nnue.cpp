@@ -0,0 +1,205 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "bithelpers.h"
+#include "board.h"
+
+#ifdef JOHNNER_EMBEDDED_NET
+extern const unsigned char EMBEDDED_NET[];
+extern const size_t EMBEDDED_NET_SIZE;
+#endif
+
+namespace choco::nnue {
+    Network* network = nullptr;
+    uint32_t generation = 0;
+
+    namespace {
+        class BufferReader {
+        public:
+            BufferReader(const uint8_t* data, size_t size) : data(data), size(size), pos(0) { }
+
+            bool read(void* out, size_t bytes) {
+                if (size - pos < bytes) return false;
+                std::memcpy(out, data + pos, bytes);
+                pos += bytes;
+                return true;
+            }
+
+            bool atEnd() const {
+                return pos == size;
+            }
+        private:
+            const uint8_t* data;
+            size_t size;
+            size_t pos;
+        };
+
+        // int16 accumulator -> uint8 activations in [0, ACTIVATION_MAX]
+        inline void clipAccumulator(const int16_t* in, uint8_t* out) {
+#if defined(NNUE_AVX2)
+            const __m256i zero = _mm256_setzero_si256();
+            for (int i = 0; i < L1; i += 32) {
+                __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i));
+                __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+                // packs works per 128-bit lane, so the 64-bit quarters need reordering afterwards
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0b11011000);
+                _mm256_store_si256(reinterpret_cast<__m256i*>(out + i), _mm256_max_epi8(packed, zero));
+            }
+#elif defined(NNUE_SSE41)
+            const __m128i zero = _mm_setzero_si128();
+            for (int i = 0; i < L1; i += 16) {
+                __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i));
+                __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+                _mm_store_si128(reinterpret_cast<__m128i*>(out + i), _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+            }
+#else
+            for (int i = 0; i < L1; i++) {
+                out[i] = (uint8_t) std::clamp<int>(in[i], 0, ACTIVATION_MAX);
+            }
+#endif
+        }
+
+        inline int32_t dot(const uint8_t* in, const int8_t* weights, int count) {
+#if defined(NNUE_AVX2)
+            const __m256i ones = _mm256_set1_epi16(1);
+            __m256i sum = _mm256_setzero_si256();
+            for (int i = 0; i < count; i += 32) {
+                __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i));
+                __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + i));
+                // u8 * i8 pairs fit in int16 since activations never exceed 127
+                sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(a, w), ones));
+            }
+            __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0b01001110));
+            s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0b10110001));
+            return _mm_cvtsi128_si32(s);
+#elif defined(NNUE_SSE41)
+            const __m128i ones = _mm_set1_epi16(1);
+            __m128i sum = _mm_setzero_si128();
+            for (int i = 0; i < count; i += 16) {
+                __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i));
+                __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + i));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(a, w), ones));
+            }
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b01001110));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0b10110001));
+            return _mm_cvtsi128_si32(sum);
+#else
+            int32_t sum = 0;
+            for (int i = 0; i < count; i++) {
+                sum += (int32_t) in[i] * weights[i];
+            }
+            return sum;
+#endif
+        }
+
+        template<int in, int out>
+        inline void affineClipped(const uint8_t* input, const int8_t (*weights)[in],
+                                  const int32_t* bias, uint8_t* output) {
+            for (int o = 0; o < out; o++) {
+                int32_t sum = bias[o] + dot(input, weights[o], in);
+                output[o] = (uint8_t) std::clamp(sum >> WEIGHT_SHIFT, 0, ACTIVATION_MAX);
+            }
+        }
+    }
+
+    bool loadMemory(const void* data, size_t size) {
+        BufferReader reader(static_cast<const uint8_t*>(data), size);
+
+        uint32_t header[5];
+        if (!reader.read(header, sizeof(header))) return false;
+        if (header[0] != FILE_MAGIC || header[1] != FILE_VERSION
+            || header[2] != L1 || header[3] != L2 || header[4] != L3) {
+            return false;
+        }
+
+        Network* net = new Network();
+        bool ok = reader.read(net->ftBias, sizeof(net->ftBias))
+               && reader.read(net->ftWeights, sizeof(net->ftWeights))
+               && reader.read(net->l2Bias, sizeof(net->l2Bias))
+               && reader.read(net->l2Weights, sizeof(net->l2Weights))
+               && reader.read(net->l3Bias, sizeof(net->l3Bias))
+               && reader.read(net->l3Weights, sizeof(net->l3Weights))
+               && reader.read(&net->outBias, sizeof(net->outBias))
+               && reader.read(net->outWeights, sizeof(net->outWeights))
+               && reader.atEnd();
+
+        if (!ok) {
+            delete net;
+            return false;
+        }
+
+        unload();
+        network = net;
+        generation++;
+        return true;
+    }
+
+    bool loadFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        return loadMemory(bytes.data(), bytes.size());
+    }
+
+    bool loadEmbedded() {
+#ifdef JOHNNER_EMBEDDED_NET
+        return loadMemory(EMBEDDED_NET, EMBEDDED_NET_SIZE);
+#else
+        return false;
+#endif
+    }
+
+    void unload() {
+        delete network;
+        network = nullptr;
+    }
+
+    void refresh(const Board& board, Accumulator& acc, uint8_t perspective) {
+        int16_t* values = acc.values[perspective];
+        std::memcpy(values, network->ftBias, sizeof(network->ftBias));
+
+        uint8_t kingSquare = countTrailingZeros(board.bitboards[perspective][KING]);
+
+        for (uint8_t color = 0; color < 2; color++) {
+            for (uint8_t piece = 0; piece < 6; piece++) {
+                iterateIndices(board.bitboards[color][piece], [&](uint8_t square) {
+                    updateColumn<true>(values, featureIndex(perspective, kingSquare, color, piece, square));
+                });
+            }
+        }
+
+        acc.dirty[perspective] = false;
+    }
+
+    int evaluate(const Board& board) {
+        Accumulator& acc = board.accumulator;
+
+        if (acc.generation != generation) {
+            acc.dirty[SIDE_WHITE] = acc.dirty[SIDE_BLACK] = true;
+            acc.generation = generation;
+        }
+        if (acc.dirty[SIDE_WHITE]) refresh(board, acc, SIDE_WHITE);
+        if (acc.dirty[SIDE_BLACK]) refresh(board, acc, SIDE_BLACK);
+
+        uint8_t us = board.state.activeColor;
+
+        alignas(64) uint8_t input[2 * L1];
+        alignas(64) uint8_t hidden2[L2];
+        alignas(64) uint8_t hidden3[L3];
+
+        clipAccumulator(acc.values[us], input);
+        clipAccumulator(acc.values[OPPOSITE_SIDE(us)], input + L1);
+
+        affineClipped<2 * L1, L2>(input, network->l2Weights, network->l2Bias, hidden2);
+        affineClipped<L2, L3>(hidden2, network->l3Weights, network->l3Bias, hidden3);
+
+        int32_t output = network->outBias + dot(hidden3, network->outWeights, L3);
+        return output / OUTPUT_SCALE;
+    }
+} // namespace choco::nnue
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NNUE_AVX2
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define NNUE_SSE41
+#endif
+
+#include "macros.h"
+
+// Optional neural network evaluation (see NNUE.md for the architecture and file format).
+// When no network is loaded, evaluate() falls back to the piece-square evaluation.
+namespace choco {
+    class Board;
+}
+
+namespace choco::nnue {
+    static constexpr int INPUTS = 64 * 12 * 64; // HalfKA: king square x (color, piece) x square
+    static constexpr int L1 = 128;              // accumulator size per perspective
+    static constexpr int L2 = 32;
+    static constexpr int L3 = 32;
+
+    static constexpr int WEIGHT_SHIFT = 6;      // hidden layer weights are scaled by 64
+    static constexpr int OUTPUT_SCALE = 16;     // network output / OUTPUT_SCALE = centipawns
+    static constexpr int ACTIVATION_MAX = 127;
+
+    static constexpr uint32_t FILE_MAGIC = 0x454E4E4A; // "JNNE"
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    struct alignas(64) Network {
+        int16_t ftBias[L1];
+        int16_t ftWeights[INPUTS][L1];
+
+        int32_t l2Bias[L2];
+        int8_t l2Weights[L2][2 * L1];
+
+        int32_t l3Bias[L3];
+        int8_t l3Weights[L3][L2];
+
+        int32_t outBias;
+        int8_t outWeights[L3];
+    };
+
+    struct alignas(64) Accumulator {
+        int16_t values[2][L1];
+        // a perspective is dirty when its king has moved (or the board was just built) and
+        // must be rebuilt from scratch before the next evaluation
+        bool dirty[2] = { true, true };
+        uint32_t generation = 0;
+    };
+
+    // one perspective as it was before its king moved, so unmaking the move can put it back
+    // instead of rebuilding it
+    struct alignas(64) SavedPerspective {
+        int16_t values[L1];
+        uint32_t generation;
+    };
+
+    extern Network* network;
+    extern uint32_t generation; // bumped every time a network is loaded
+
+    inline bool isEnabled() {
+        return network != nullptr;
+    }
+
+    bool loadFile(const std::string& path);
+    bool loadMemory(const void* data, size_t size);
+    void unload();
+    // loads the network embedded at build time, if there is one
+    bool loadEmbedded();
+
+    constexpr inline int featureIndex(uint8_t perspective, uint8_t kingSquare,
+                                      uint8_t color, uint8_t piece, uint8_t square) {
+        // everything is seen from the perspective's own side of the board
+        uint8_t flip = (perspective == SIDE_WHITE) ? 0 : 56;
+        return ((kingSquare ^ flip) * 12 + (color != perspective) * 6 + piece) * 64 + (square ^ flip);
+    }
+
+    template<bool add>
+    inline void updateColumn(int16_t* values, int feature) {
+        const int16_t* column = network->ftWeights[feature];
+#if defined(NNUE_AVX2)
+        for (int i = 0; i < L1; i += 16) {
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(values + i));
+            __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(column + i));
+            v = add ? _mm256_add_epi16(v, w) : _mm256_sub_epi16(v, w);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(values + i), v);
+        }
+#elif defined(NNUE_SSE41)
+        for (int i = 0; i < L1; i += 8) {
+            __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(values + i));
+            __m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(column + i));
+            v = add ? _mm_add_epi16(v, w) : _mm_sub_epi16(v, w);
+            _mm_store_si128(reinterpret_cast<__m128i*>(values + i), v);
+        }
+#else
+        for (int i = 0; i < L1; i++) {
+            values[i] = add ? values[i] + column[i] : values[i] - column[i];
+        }
+#endif
+    }
+
+    // adds or removes one piece from both perspectives. kingSquares are INVALID_SQUARE when
+    // the king is missing, which only happens while a board is being set up
+    template<bool add>
+    inline void updatePiece(Accumulator& acc, const uint8_t kingSquares[2],
+                            uint8_t color, uint8_t piece, uint8_t square) {
+        for (uint8_t perspective = 0; perspective < 2; perspective++) {
+            if (acc.dirty[perspective]) continue;
+            if (piece == KING && color == perspective) {
+                acc.dirty[perspective] = true;
+                continue;
+            }
+
+            updateColumn<add>(acc.values[perspective],
+                              featureIndex(perspective, kingSquares[perspective], color, piece, square));
+        }
+    }
+
+    void refresh(const Board& board, Accumulator& acc, uint8_t perspective);
+
+    // centipawns from the side to move's point of view
+    int evaluate(const Board& board);
+} // namespace choco::nnue
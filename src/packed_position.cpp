@@ -0,0 +1,47 @@
+#include "packed_position.h"
+
+#include "bithelpers.h"
+
+namespace choco {
+    PackedPosition packPosition(const Board& board, int16_t score, uint8_t result) {
+        PackedPosition packed{};
+        packed.occupancy = board.occupiedSquares[SIDE_WHITE] | board.occupiedSquares[SIDE_BLACK];
+
+        int i = 0;
+        iterateIndices(packed.occupancy, [&](uint8_t square) {
+            uint8_t side = (board.occupiedSquares[SIDE_WHITE] & getMask(square)) ? SIDE_WHITE : SIDE_BLACK;
+            uint8_t nibble = (uint8_t) (side << 3 | getPieceOnSquare(board.bitboards[side], square));
+            packed.pieces[i / 2] |= nibble << (4 * (i % 2));
+            i++;
+        });
+
+        packed.score = score;
+        packed.flags = (uint8_t) (board.state.activeColor | board.state.castling << 1);
+        packed.enpassant = IS_VALID_SQUARE(board.state.enpassantSquare) ? board.state.enpassantSquare
+                                                                        : PackedPosition::NO_ENPASSANT;
+        packed.result = result;
+        packed.halfMoveClock = board.state.halfMoveClock;
+        packed.moveCount = board.state.moveCount;
+        return packed;
+    }
+
+    Board unpackPosition(const PackedPosition& packed) {
+        Board board;
+
+        int i = 0;
+        iterateIndices(packed.occupancy, [&](uint8_t square) {
+            uint8_t nibble = (packed.pieces[i / 2] >> (4 * (i % 2))) & 15;
+            if (isValidPiece(nibble & 7)) board.placePiece(nibble >> 3, nibble & 7, square);
+            i++;
+        });
+
+        GameState state = board.state;
+        state.activeColor = packed.flags & 1;
+        state.castling = (packed.flags >> 1) & 15;
+        state.enpassantSquare = packed.enpassant < 64 ? packed.enpassant : INVALID_SQUARE;
+        state.halfMoveClock = packed.halfMoveClock;
+        state.moveCount = packed.moveCount;
+        board.setState(state);
+        return board;
+    }
+} // namespace choco
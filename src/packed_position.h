@@ -0,0 +1,40 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+#include "board.h"
+
+namespace choco {
+    // A position with its search score and game result in 32 bytes, the record format of
+    // johnner_datagen files. Files are plain arrays of records in the host's (little-endian) layout.
+    struct PackedPosition {
+        uint64_t occupancy;  // every occupied square
+        uint8_t pieces[16];  // a nibble per occupied square in ascending order, low nibble first: side << 3 | piece
+        int16_t score;       // centipawns from the side to move's point of view
+        uint8_t flags;       // bit 0: side to move, bits 1-4: castling rights as in GameState, bit 5: NO_SCORE
+        uint8_t enpassant;   // en passant square, or NO_ENPASSANT
+        uint8_t result;      // RESULT_* for white
+        uint8_t halfMoveClock;
+        uint16_t moveCount;
+
+        static constexpr uint8_t NO_ENPASSANT = 64;
+        // score is 0 because none is known, e.g. for a position from a PGN game without engine comments
+        static constexpr uint8_t NO_SCORE = 1 << 5;
+
+        static constexpr uint8_t RESULT_BLACK_WIN = 0;
+        static constexpr uint8_t RESULT_DRAW = 1;
+        static constexpr uint8_t RESULT_WHITE_WIN = 2;
+    };
+
+    static_assert(sizeof(PackedPosition) == 32);
+    static_assert(std::endian::native == std::endian::little);
+
+    PackedPosition packPosition(const Board& board, int16_t score, uint8_t result);
+    Board unpackPosition(const PackedPosition& packed);
+
+    // 1, 0.5 or 0 for white
+    inline float resultForWhite(const PackedPosition& packed) {
+        return packed.result * 0.5f;
+    }
+} // namespace choco
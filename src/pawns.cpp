@@ -0,0 +1,148 @@
+#include "pawns.h"
+
+#include <array>
+
+#include "bithelpers.h"
+#include "macros.h"
+
+namespace choco {
+    namespace {
+        constexpr Score DOUBLED_PENALTY  = makeScore(-10, -25);
+        constexpr Score ISOLATED_PENALTY = makeScore(-12, -15);
+        constexpr Score BACKWARD_PENALTY = makeScore( -8, -12);
+
+        // indexed by rank relative to the pawn's side
+        constexpr Score PASSED_BONUS[8] = {
+            makeScore(0, 0),   makeScore(5, 10),  makeScore(8, 15),   makeScore(12, 30),
+            makeScore(25, 55), makeScore(45, 90), makeScore(70, 140), makeScore(0, 0),
+        };
+
+        // own pawns one and two ranks in front of the king
+        constexpr Score SHIELD_BONUS[2] = { makeScore(10, 0), makeScore(5, 0) };
+
+        constexpr uint64_t fileMask(int file) {
+            return BITBOARD_FILE_A << file;
+        }
+
+        constexpr uint64_t adjacentFiles(int file) {
+            return (file > 0 ? fileMask(file - 1) : 0) | (file < 7 ? fileMask(file + 1) : 0);
+        }
+
+        // every rank strictly in front of the given rank, from side's point of view
+        constexpr uint64_t forwardRanks(uint8_t side, int rank) {
+            if (side == SIDE_WHITE) return rank == 7 ? 0 : ~0ULL << (8 * (rank + 1));
+            return rank == 0 ? 0 : ~0ULL >> (8 * (8 - rank));
+        }
+
+        struct PawnMasks {
+            uint64_t passed[2][64];  // squares that must be free of enemy pawns for a pawn to be passed
+            uint64_t support[2][64]; // adjacent squares at or behind a pawn that friendly pawns could support from
+            uint64_t shield[2][64][2];
+        };
+
+        constexpr PawnMasks makePawnMasks() {
+            PawnMasks masks{};
+
+            for (uint8_t side = 0; side < 2; side++) {
+                for (int square = 0; square < 64; square++) {
+                    int rank = square / 8;
+                    int file = square % 8;
+                    uint64_t ahead = forwardRanks(side, rank);
+                    uint64_t files = fileMask(file) | adjacentFiles(file);
+
+                    masks.passed[side][square] = ahead & files;
+                    masks.support[side][square] = ~ahead & adjacentFiles(file);
+
+                    for (int dist = 1; dist <= 2; dist++) {
+                        int shieldRank = (side == SIDE_WHITE) ? rank + dist : rank - dist;
+                        if (shieldRank < 0 || shieldRank > 7) continue;
+                        masks.shield[side][square][dist - 1] = files & (BITBOARD_RANK_1 << (8 * shieldRank));
+                    }
+                }
+            }
+
+            return masks;
+        }
+
+        constexpr PawnMasks PAWN_MASKS = makePawnMasks();
+
+        template<uint8_t Side>
+        inline uint64_t pawnAttacks(uint64_t pawns) {
+            if constexpr (Side == SIDE_WHITE) return ((pawns & ~BITBOARD_FILE_A) << 7) | ((pawns & ~BITBOARD_FILE_H) << 9);
+            return ((pawns & ~BITBOARD_FILE_A) >> 9) | ((pawns & ~BITBOARD_FILE_H) >> 7);
+        }
+
+        template<uint8_t Side>
+        Score evaluateSide(uint64_t ownPawns, uint64_t oppPawns, uint64_t& passed) {
+            Score score = 0;
+            uint64_t oppAttacks = pawnAttacks<oppositeSide(Side)>(oppPawns);
+
+            for (int file = 0; file < 8; file++) {
+                uint8_t count = countOnes(ownPawns & fileMask(file));
+                if (count > 1) score += DOUBLED_PENALTY * (count - 1);
+            }
+
+            iterateIndices(ownPawns, [&](uint8_t square) {
+                uint8_t file = getFile(square);
+                uint8_t relativeRank = (Side == SIDE_WHITE) ? getRank(square) : 7 - getRank(square);
+
+                if (!(ownPawns & adjacentFiles(file))) {
+                    score += ISOLATED_PENALTY;
+                } else if (!(ownPawns & PAWN_MASKS.support[Side][square])) {
+                    uint8_t stop = (Side == SIDE_WHITE) ? square + 8 : square - 8;
+                    if (oppAttacks & getMask(stop)) score += BACKWARD_PENALTY;
+                }
+
+                if (!(oppPawns & PAWN_MASKS.passed[Side][square])) {
+                    passed |= getMask(square);
+                    score += PASSED_BONUS[relativeRank];
+                }
+            });
+
+            return score;
+        }
+
+        template<uint8_t Side>
+        Score kingShield(const Board& board) {
+            uint64_t king = board.bitboards[Side][KING];
+            if (!king) return 0;
+
+            uint8_t square = countTrailingZeros(king);
+            uint64_t pawns = board.bitboards[Side][PAWN];
+            return SHIELD_BONUS[0] * countOnes(pawns & PAWN_MASKS.shield[Side][square][0])
+                 + SHIELD_BONUS[1] * countOnes(pawns & PAWN_MASKS.shield[Side][square][1]);
+        }
+    }
+
+    PawnTable::PawnTable() : entries(PAWN_TABLE_SIZE) { }
+
+    PawnEntry& PawnTable::probe(const Board& board) {
+        PawnEntry& entry = entries[board.pawnKey & PAWN_TABLE_MASK];
+
+        if (!entry.valid || entry.key != board.pawnKey) {
+            entry.key = board.pawnKey;
+            entry.score = evaluatePawnStructure(board, entry);
+            entry.valid = true;
+        }
+
+        return entry;
+    }
+
+    void PawnTable::clear() {
+        std::fill(entries.begin(), entries.end(), PawnEntry());
+    }
+
+    Score evaluatePawnStructure(const Board& board, PawnEntry& entry) {
+        uint64_t white = board.bitboards[SIDE_WHITE][PAWN];
+        uint64_t black = board.bitboards[SIDE_BLACK][PAWN];
+
+        entry.passed[SIDE_WHITE] = entry.passed[SIDE_BLACK] = 0;
+
+        return evaluateSide<SIDE_WHITE>(white, black, entry.passed[SIDE_WHITE])
+             - evaluateSide<SIDE_BLACK>(black, white, entry.passed[SIDE_BLACK]);
+    }
+
+    Score evaluateKingShield(const Board& board) {
+        return kingShield<SIDE_WHITE>(board) - kingShield<SIDE_BLACK>(board);
+    }
+} // namespace choco
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "board.h"
+#include "psqt.h"
+
+namespace choco {
+    struct PawnEntry {
+        uint64_t key = 0;
+        Score score = 0;         // pawn structure terms, white's point of view
+        uint64_t passed[2] = {}; // passed pawns of each side
+        bool valid = false;
+    };
+
+    // Pawn structures repeat across a huge number of nodes, so their evaluation is cached by
+    // Board::pawnKey. Each search thread owns its own table.
+    class PawnTable {
+    public:
+        PawnTable();
+
+        PawnEntry& probe(const Board& board);
+        void clear();
+    private:
+        static constexpr int PAWN_TABLE_BITS = 14;
+        static constexpr size_t PAWN_TABLE_SIZE = 1 << PAWN_TABLE_BITS;
+        static constexpr uint64_t PAWN_TABLE_MASK = PAWN_TABLE_SIZE - 1;
+
+        std::vector<PawnEntry> entries;
+    };
+
+    // doubled, isolated, backward and passed pawns; depends on the pawns alone
+    Score evaluatePawnStructure(const Board& board, PawnEntry& entry);
+
+    // pawn shield in front of each king; depends on the king squares and is computed per node
+    Score evaluateKingShield(const Board& board);
+} // namespace choco
@@ -0,0 +1,130 @@
+#include "perf_counters.h"
+
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace choco {
+    namespace {
+        constexpr const char* EVENT_NAMES[PERF_EVENT_COUNT] = {
+            "cycles", "instructions", "branch-misses", "l1d-misses", "llc-misses", "dtlb-misses"
+        };
+
+#ifdef __linux__
+        constexpr uint64_t cacheConfig(uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+
+        constexpr struct { uint32_t type; uint64_t config; } EVENTS[PERF_EVENT_COUNT] = {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+            { PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_L1D) },
+            { PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_LL) },
+            { PERF_TYPE_HW_CACHE, cacheConfig(PERF_COUNT_HW_CACHE_DTLB) },
+        };
+
+        int openEvent(uint32_t type, uint64_t config) {
+            perf_event_attr attr = {};
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // pid 0, cpu -1: the calling thread on whichever CPU it runs
+            return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+#endif
+    }
+
+    PerfSample& PerfSample::operator+=(const PerfSample& other) {
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            values[i] += other.values[i];
+            valid[i] = valid[i] || other.valid[i];
+        }
+        return *this;
+    }
+
+    bool PerfSample::any() const {
+        for (bool v : valid) {
+            if (v) return true;
+        }
+        return false;
+    }
+
+    std::string PerfSample::toString(uint64_t nodes) const {
+        if (!any()) return "info string perf counters unavailable";
+
+        std::ostringstream out;
+        out << "info string perf";
+        if (valid[PERF_CYCLES] && valid[PERF_INSTRUCTIONS] && values[PERF_CYCLES] > 0) {
+            out << " ipc " << (double) values[PERF_INSTRUCTIONS] / values[PERF_CYCLES];
+        }
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            if (!valid[i]) continue;
+            out << " " << EVENT_NAMES[i] << " " << values[i];
+            if (nodes > 0) out << " (" << (double) values[i] / nodes << "/node)";
+        }
+        return out.str();
+    }
+
+    PerfCounters::PerfCounters() {
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+#ifdef __linux__
+            fds[i] = openEvent(EVENTS[i].type, EVENTS[i].config);
+#else
+            fds[i] = -1;
+#endif
+        }
+    }
+
+    PerfCounters::~PerfCounters() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+#endif
+    }
+
+    bool PerfCounters::available() const {
+        for (int fd : fds) {
+            if (fd >= 0) return true;
+        }
+        return false;
+    }
+
+    void PerfCounters::start() {
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    PerfSample PerfCounters::stop() {
+        PerfSample sample;
+#ifdef __linux__
+        for (int i = 0; i < PERF_EVENT_COUNT; i++) {
+            if (fds[i] < 0) continue;
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+            uint64_t data[3]; // value, time enabled, time running
+            if (read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+
+            sample.values[i] = (uint64_t) ((double) data[0] * data[1] / data[2]);
+            sample.valid[i] = true;
+        }
+#endif
+        return sample;
+    }
+} // namespace choco
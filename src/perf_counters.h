@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace choco {
+    enum PerfEvent {
+        PERF_CYCLES,
+        PERF_INSTRUCTIONS,
+        PERF_BRANCH_MISSES,
+        PERF_L1D_MISSES,
+        PERF_LLC_MISSES,
+        PERF_DTLB_MISSES,
+        PERF_EVENT_COUNT
+    };
+
+    struct PerfSample {
+        uint64_t values[PERF_EVENT_COUNT] = {};
+        bool valid[PERF_EVENT_COUNT] = {}; // false for events the kernel or CPU doesn't provide
+
+        PerfSample& operator+=(const PerfSample& other);
+
+        bool any() const;
+        // "info string perf ..." with IPC and each event per node
+        std::string toString(uint64_t nodes) const;
+    };
+
+    // Hardware counters for the calling thread, read through Linux perf_event_open. Each event is
+    // opened on its own, so an event the CPU lacks (common in VMs) is simply missing from the sample.
+    // Counts are scaled up when the kernel had to multiplex the counters. On other platforms, or
+    // when perf_event_paranoid forbids access, nothing is available and samples are empty.
+    class PerfCounters {
+    public:
+        PerfCounters();
+        ~PerfCounters();
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        bool available() const;
+
+        void start();
+        PerfSample stop();
+    private:
+        int fds[PERF_EVENT_COUNT];
+    };
+} // namespace choco
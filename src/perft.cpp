@@ -1,9 +1,19 @@
+#include "perft.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <iostream>
 #include <cstdlib>
+#include <future>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "board.h"
 #include "bithelpers.h"
+#include "thread_pool.h"
+#include "uci.h"
 
 namespace choco {
     unsigned char pieceCharToType(uint8_t pieceType) {
@@ -61,55 +71,111 @@ namespace choco {
         return move;
     }
 
-    uint32_t propagate(int depth, choco::Board& board) {
-        if (depth == 0) return 1;
+    namespace {
+        // Shared between the perft workers without locks. Each slot stores its data word next to
+        // key ^ data, so a slot torn by a concurrent write fails the key check instead of returning
+        // another position's count.
+        class PerftTable {
+        public:
+            explicit PerftTable(size_t megabytes)
+                : entries(std::bit_floor(std::max<size_t>(megabytes * 1024 * 1024 / sizeof(Entry), 1))),
+                  mask(entries.size() - 1) { }
+
+            bool probe(uint64_t key, int depth, uint64_t& count) const {
+                const Entry& e = entries[key & mask];
+                uint64_t data = e.data.load(std::memory_order_relaxed);
+                uint64_t check = e.check.load(std::memory_order_relaxed);
+
+                if ((check ^ data) != key || (int) (data & 0xFF) != depth) return false;
+                count = data >> 8;
+                return true;
+            }
+
+            void store(uint64_t key, int depth, uint64_t count) {
+                Entry& e = entries[key & mask];
+                uint64_t data = (count << 8) | (uint64_t) depth;
+                e.data.store(data, std::memory_order_relaxed);
+                e.check.store(key ^ data, std::memory_order_relaxed);
+            }
+        private:
+            struct Entry {
+                std::atomic<uint64_t> check{0};
+                std::atomic<uint64_t> data{0};
+            };
+
+            std::vector<Entry> entries;
+            uint64_t mask;
+        };
+
+        template<PerftMode mode>
+        uint64_t propagate(int depth, Board& board, PerftTable* table) {
+            if constexpr (mode == PerftMode::BULK) {
+                if (depth == 1) return board.generateLegalMoves().size();
+            }
+            if (depth == 0) return 1;
 
-        uint32_t nodesSearched = 0;
+            uint64_t nodesSearched = 0;
+            // depth 1 entries would cost as much to look up as to recount
+            if (table && depth > 1 && table->probe(board.key, depth, nodesSearched)) return nodesSearched;
 
-        for (const choco::Move& move : board.generatePLMoves()) {
-            choco::UnmakeMove unmakeMove = board.makeMove(move);
-            if (!unmakeMove.isValid()) continue;
+            for (const Move& move : board.generatePLMoves()) {
+                UnmakeMove unmakeMove = board.makeMove(move);
+                if (!unmakeMove.isValid()) continue;
 
-            nodesSearched += propagate(depth - 1, board);
-            board.unmakeMove(unmakeMove);
+                nodesSearched += propagate<mode>(depth - 1, board, table);
+                board.unmakeMove(unmakeMove);
+            }
+
+            if (table && depth > 1) table->store(board.key, depth, nodesSearched);
+            return nodesSearched;
         }
-        
-        return nodesSearched;
     }
 
-    uint32_t perft(Board& board, int depth, bool initBB, bool print) {
-        if (depth == 0) {
-            std::cout << "1" << std::endl;
+    uint64_t perft(const Board& board, int depth, const PerftOptions& options) {
+        if (depth <= 0) {
+            if (options.print) std::cout << "\n1" << std::endl;
             return 1;
         }
 
-        uint32_t nodesSearched = 0;
+        std::unique_ptr<PerftTable> table;
+        if (options.hashMb > 0) table = std::make_unique<PerftTable>(options.hashMb);
 
-        if (initBB) {
-            choco::initBitboards();
+        Board root = board;
+        std::vector<Move> rootMoves;
+        for (const Move& move : root.generatePLMoves()) {
+            UnmakeMove unmakeMove = root.makeMove(move);
+            if (!unmakeMove.isValid()) continue;
+            root.unmakeMove(unmakeMove);
+            rootMoves.push_back(move);
         }
 
-        for (const choco::Move& move : board.generatePLMoves()) {
-            choco::UnmakeMove unmakeMove = board.makeMove(move);
-            if (!unmakeMove.isValid()) continue;
-            
-            if (IS_VALID_PIECE(move.promotionType)) {
-                std::cout << pieceCharToType(move.promotionType);
+        // one task per root move; each works on its own copy of the board
+        std::vector<std::future<uint64_t>> counts;
+        counts.reserve(rootMoves.size());
+        {
+            ThreadPool pool(std::max(options.threads, 1));
+            for (const Move& move : rootMoves) {
+                counts.push_back(pool.submit([&board, &table, &options, move, depth]() {
+                    Board child = board;
+                    child.makeMove(move);
+                    return options.mode == PerftMode::BULK
+                           ? propagate<PerftMode::BULK>(depth - 1, child, table.get())
+                           : propagate<PerftMode::MAKE_UNMAKE>(depth - 1, child, table.get());
+                }));
             }
+        }
 
-            uint32_t nodesThisTime = propagate(depth - 1, board);
+        uint64_t nodesSearched = 0;
+        for (size_t i = 0; i < rootMoves.size(); i++) {
+            uint64_t nodesThisTime = counts[i].get();
             nodesSearched += nodesThisTime;
-            board.unmakeMove(unmakeMove);
 
-            if (print) {
-                std::cout << (char)(choco::getFile(move.from) + 'a') << (char)(choco::getRank(move.from) + '1')
-                        << (char)(choco::getFile(move.to) + 'a') << (char)(choco::getRank(move.to) + '1')
-                        << " "
-                        << std::to_string(nodesThisTime) << std::endl;
+            if (options.print) {
+                std::cout << moveToUci(rootMoves[i]) << " " << std::to_string(nodesThisTime) << std::endl;
             }
         }
 
-        if (print) {
+        if (options.print) {
             std::cout << "\n" << std::to_string(nodesSearched) << std::endl;
         }
 
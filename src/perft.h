@@ -1,10 +1,22 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+
 #include "board.h"
 
 namespace choco {
-    uint32_t perft(Board& board,
-               int depth,
-               bool initBB,
-               bool print);
+    enum class PerftMode {
+        MAKE_UNMAKE, // makes and unmakes every move down to the leaves; exercises makeMove's legality check
+        BULK         // counts legal moves at the last ply without making them
+    };
+
+    struct PerftOptions {
+        PerftMode mode = PerftMode::BULK;
+        int threads = 1;    // root moves are split across this many workers
+        size_t hashMb = 0;  // size of the shared (key, depth) -> count table; 0 disables it
+        bool print = false; // divide output: each root move's count, then the total
+    };
+
+    uint64_t perft(const Board& board, int depth, const PerftOptions& options = {});
 } // namespace choco
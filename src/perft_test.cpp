@@ -1,30 +1,242 @@
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <cstdlib>
- #include <chrono>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <vector>
 
 #include "board.h"
+#include "epd.h"
+#include "bithelpers.h"
 #include "perft.h"
+#include "str_util.h"
+#include "thread_pool.h"
 
-#define DEBUG_PERFT
+namespace {
+    void printUsage() {
+        std::cerr << "usage: johnner_perft <depth> <fen> [--threads N] [--hash MB] [--mode bulk|make|both]\n"
+                  << "       johnner_perft --suite <file.epd> [--depth N] [--threads N] [--hash MB] [--mode bulk|make|both]"
+                  << std::endl;
+    }
+
+    const char* modeName(choco::PerftMode mode) {
+        return mode == choco::PerftMode::BULK ? "bulk" : "make";
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct Arguments {
+        int depth = 0;
+        std::string target; // fen, or the EPD path in suite mode
+        bool suite = false;
+        int threads = 0;    // 0 means one per hardware thread in suite mode, 1 otherwise
+        size_t hashMb = 0;
+        std::vector<choco::PerftMode> modes = { choco::PerftMode::BULK };
+    };
+
+    bool parseArguments(int argc, char* argv[], Arguments& args) {
+        if (argc < 3) return false;
+
+        if (std::string_view(argv[1]) == "--suite") {
+            args.suite = true;
+            args.depth = 64; // every depth in the file
+        } else {
+            std::optional<int> depth = choco::util::parseNumber<int>(argv[1]);
+            if (!depth) return false;
+            args.depth = *depth;
+        }
+        args.target = argv[2];
+
+        if ((argc - 3) % 2 != 0) return false;
+
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string_view flag = argv[i];
+            std::string_view value = argv[i + 1];
+
+            if (flag == "--threads") {
+                args.threads = choco::util::parseNumber<int>(value).value_or(-1);
+                if (args.threads < 1) return false;
+            } else if (flag == "--hash") {
+                std::optional<size_t> hash = choco::util::parseNumber<size_t>(value);
+                if (!hash) return false;
+                args.hashMb = *hash;
+            } else if (flag == "--depth" && args.suite) {
+                args.depth = choco::util::parseNumber<int>(value).value_or(-1);
+                if (args.depth < 1) return false;
+            } else if (flag == "--mode" && value == "bulk") {
+                args.modes = { choco::PerftMode::BULK };
+            } else if (flag == "--mode" && value == "make") {
+                args.modes = { choco::PerftMode::MAKE_UNMAKE };
+            } else if (flag == "--mode" && value == "both") {
+                args.modes = { choco::PerftMode::MAKE_UNMAKE, choco::PerftMode::BULK };
+            } else {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    int runSingle(const Arguments& args) {
+        choco::Board board;
+        const char* error = nullptr;
+        if (!board.loadFen(args.target, &error)) {
+            std::cerr << "invalid fen: " << error << std::endl;
+            return 1;
+        }
+
+        choco::PerftOptions options;
+        options.threads = std::max(args.threads, 1);
+        options.hashMb = args.hashMb;
+        // divide output only makes sense once; with both modes the totals are compared instead
+        options.print = args.modes.size() == 1;
+
+        uint64_t expected = 0;
+        int status = 0;
+
+        for (choco::PerftMode mode : args.modes) {
+            options.mode = mode;
+
+            auto start = std::chrono::steady_clock::now();
+            uint64_t nodesSearched = choco::perft(board, args.depth, options);
+            double elapsed = secondsSince(start);
+
+            std::cout << modeName(mode) << ": " << nodesSearched << " nodes in " << elapsed << "s, "
+                      << (uint64_t) (nodesSearched / elapsed) << " nps" << std::endl;
+
+            if (mode != args.modes.front() && nodesSearched != expected) {
+                std::cout << "mismatch: " << modeName(args.modes.front()) << " counted " << expected << std::endl;
+                status = 1;
+            }
+            expected = nodesSearched;
+        }
+
+        return status;
+    }
+
+    // one EPD line: "<fen> ;D1 20 ;D2 400 ..."
+    struct SuiteEntry {
+        std::string fen;
+        std::vector<std::pair<int, uint64_t>> expected; // (depth, count)
+    };
+
+    bool parseSuiteRecord(const choco::epd::Record& record, SuiteEntry& entry) {
+        choco::Board board;
+        if (!board.loadFen(record.fen)) return false;
+        entry.fen = record.fen;
+
+        std::string_view operations = record.operations;
+        while (std::optional<choco::epd::Operation> operation = choco::epd::nextOperation(operations)) {
+            if (!operation->opcode.starts_with('D')) return false;
+
+            std::optional<int> depth = choco::util::parseNumber<int>(operation->opcode.substr(1));
+            std::optional<uint64_t> count = choco::util::parseNumber<uint64_t>(operation->operand);
+            if (!depth || !count) return false;
+
+            entry.expected.emplace_back(*depth, *count);
+        }
+
+        return !entry.expected.empty();
+    }
+
+    struct SuiteResult {
+        bool passed = true;
+        uint64_t nodes = 0;
+        double seconds = 0;
+        std::string failures;
+    };
+
+    int runSuite(const Arguments& args) {
+        choco::epd::Reader reader;
+        if (!reader.open(args.target)) {
+            std::cerr << "cannot open " << args.target << std::endl;
+            return 1;
+        }
+
+        std::vector<SuiteEntry> entries;
+        choco::epd::Record record;
+        while (reader.next(record)) {
+            SuiteEntry entry;
+            if (!parseSuiteRecord(record, entry)) {
+                std::cerr << args.target << ":" << record.line << ": malformed EPD line" << std::endl;
+                return 1;
+            }
+            entries.push_back(std::move(entry));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        // positions run in parallel, one single-threaded perft each
+        std::vector<std::future<SuiteResult>> results;
+        choco::ThreadPool pool(args.threads);
+        for (const SuiteEntry& entry : entries) {
+            results.push_back(pool.submit([&args, &entry]() {
+                SuiteResult result;
+                choco::Board board(entry.fen);
+
+                choco::PerftOptions options;
+                options.hashMb = args.hashMb;
+
+                auto positionStart = std::chrono::steady_clock::now();
+                for (choco::PerftMode mode : args.modes) {
+                    options.mode = mode;
+
+                    for (const auto& [depth, expected] : entry.expected) {
+                        if (depth > args.depth) continue;
+
+                        uint64_t nodes = choco::perft(board, depth, options);
+                        result.nodes += nodes;
+
+                        if (nodes != expected) {
+                            result.passed = false;
+                            result.failures += std::string(" ") + modeName(mode) + " D" + std::to_string(depth)
+                                             + " expected " + std::to_string(expected) + " got " + std::to_string(nodes);
+                        }
+                    }
+                }
+                result.seconds = secondsSince(positionStart);
+
+                return result;
+            }));
+        }
+
+        size_t passed = 0;
+        uint64_t totalNodes = 0;
+
+        for (size_t i = 0; i < entries.size(); i++) {
+            SuiteResult result = results[i].get();
+            passed += result.passed;
+            totalNodes += result.nodes;
+
+            char prefix[64];
+            std::snprintf(prefix, sizeof(prefix), "[%3zu/%zu] %s %12llu nodes %8.2f Mnps  ",
+                          i + 1, entries.size(), result.passed ? "PASS" : "FAIL",
+                          (unsigned long long) result.nodes,
+                          result.seconds > 0 ? result.nodes / result.seconds / 1e6 : 0.0);
+            std::cout << prefix << entries[i].fen << result.failures << std::endl;
+        }
+
+        double elapsed = secondsSince(start);
+        std::cout << "\n" << passed << "/" << entries.size() << " passed, " << totalNodes << " nodes in "
+                  << elapsed << "s, " << (uint64_t) (totalNodes / elapsed) << " nps" << std::endl;
+
+        return passed == entries.size() ? 0 : 1;
+    }
+}
 
 int main(int argc, char* argv[]) {
-    int depth = std::atoi(argv[1]);
-    std::string fen = std::string(argv[2]);
-
-#ifdef DEBUG_PERFT
-    auto start = std::chrono::steady_clock::now();
-#endif
-    choco::Board board(fen);
-    uint32_t nodesSearched = choco::perft(board, depth, true, true);
-#ifdef DEBUG_PERFT
-    auto end = std::chrono::steady_clock::now();
-#endif
-
-#ifdef DEBUG_PERFT
-    std::chrono::duration<double> elapsed = end - start;
-    double elapsed_seconds = elapsed.count();
-    std::cout << "Elapsed time: " << elapsed_seconds << "s" << std::endl;
-    std::cout << "Avg. nps: " << std::to_string(nodesSearched / elapsed_seconds) << std::endl;
-    std::cout << "Avg. spn: " << std::to_string(elapsed_seconds / nodesSearched) << std::endl;
-#endif
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        printUsage();
+        return 1;
+    }
+
+    choco::initBitboards();
+
+    return args.suite ? runSuite(args) : runSingle(args);
 }
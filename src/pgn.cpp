@@ -0,0 +1,306 @@
+#include "pgn.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "bithelpers.h"
+#include "macros.h"
+#include "str_util.h"
+
+namespace choco::pgn {
+    namespace {
+        // SAN letters, indexed by piece type
+        constexpr std::string_view PIECE_LETTERS = "KQBNR";
+        constexpr std::string_view SPACE = " \t\r\n";
+
+        uint8_t pieceFromLetter(char letter) {
+            size_t piece = PIECE_LETTERS.find(letter);
+            return piece == std::string_view::npos ? INVALID_PIECE : (uint8_t) piece;
+        }
+
+        bool isResult(std::string_view token) {
+            return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+        }
+
+        bool isCastling(const Move& move) {
+            return move.pieceType == KING && std::abs(move.to - move.from) == 2;
+        }
+
+        // drops everything up to and including the next newline
+        void skipLine(std::string_view& text) {
+            size_t newline = text.find('\n');
+            text = newline == std::string_view::npos ? std::string_view() : text.substr(newline + 1);
+        }
+
+        // [Name "value"]; false if the line isn't a tag pair
+        bool parseTag(std::string_view line, Tag& tag) {
+            line = util::trim(line);
+            if (line.size() < 2 || line.front() != '[' || line.back() != ']') return false;
+            line = util::trim(line.substr(1, line.size() - 2));
+
+            size_t space = line.find_first_of(SPACE);
+            if (space == std::string_view::npos) return false;
+            tag.name = line.substr(0, space);
+
+            std::string_view value = util::trim(line.substr(space));
+            if (value.size() < 2 || value.front() != '"') return false;
+            // the closing quote is the first one that isn't escaped
+            size_t end = 1;
+            while (end < value.size() && value[end] != '"') end += value[end] == '\\' ? 2 : 1;
+            if (end >= value.size()) return false;
+            tag.value = value.substr(1, end - 1);
+            return true;
+        }
+    }
+
+    std::optional<std::string_view> Game::tag(std::string_view name) const {
+        for (const Tag& tag : tags) {
+            if (tag.name == name) return tag.value;
+        }
+        return std::nullopt;
+    }
+
+    std::optional<Move> sanToMove(const Board& board, std::string_view san) {
+        while (!san.empty() && std::string_view("+#!?").find(san.back()) != std::string_view::npos) san.remove_suffix(1);
+
+        MoveList legal = board.generateLegalMoves();
+
+        if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+            uint8_t file = san.size() == 3 ? 6 : 2;
+            for (const Move& move : legal) {
+                if (isCastling(move) && getFile(move.to) == file) return move;
+            }
+            return std::nullopt;
+        }
+
+        uint8_t piece = PAWN;
+        if (!san.empty() && isValidPiece(pieceFromLetter(san.front()))) {
+            piece = pieceFromLetter(san.front());
+            san.remove_prefix(1);
+        }
+
+        uint8_t promotion = INVALID_PIECE;
+        if (piece == PAWN && !san.empty() && isValidPiece(pieceFromLetter(san.back()))) {
+            promotion = pieceFromLetter(san.back());
+            san.remove_suffix(1);
+            if (!san.empty() && san.back() == '=') san.remove_suffix(1);
+        }
+
+        if (san.size() < 2) return std::nullopt;
+        char toFile = san[san.size() - 2];
+        char toRank = san[san.size() - 1];
+        if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8') return std::nullopt;
+        uint8_t to = getIndex(toRank - '1', toFile - 'a');
+        san.remove_suffix(2);
+
+        // what is left says where the piece comes from, if that's needed
+        int fromFile = -1;
+        int fromRank = -1;
+        for (char c : san) {
+            if (c >= 'a' && c <= 'h') fromFile = c - 'a';
+            else if (c >= '1' && c <= '8') fromRank = c - '1';
+            else if (c != 'x' && c != '-' && c != ':') return std::nullopt;
+        }
+
+        std::optional<Move> found;
+        for (const Move& move : legal) {
+            if (move.pieceType != piece || move.to != to || move.promotionType != promotion) continue;
+            if (fromFile >= 0 && getFile(move.from) != fromFile) continue;
+            if (fromRank >= 0 && getRank(move.from) != fromRank) continue;
+            if (found) return std::nullopt;
+            found = move;
+        }
+        return found;
+    }
+
+    std::string moveToSan(const Board& board, const Move& move) {
+        uint8_t them = oppositeSide(board.state.activeColor);
+        std::string san;
+
+        if (isCastling(move)) {
+            san = getFile(move.to) == 6 ? "O-O" : "O-O-O";
+        } else {
+            bool capture = (board.occupiedSquares[them] & getMask(move.to))
+                           || (move.pieceType == PAWN && move.to == board.state.enpassantSquare);
+
+            if (move.pieceType == PAWN) {
+                if (capture) san += (char) ('a' + getFile(move.from));
+            } else {
+                san += PIECE_LETTERS[move.pieceType];
+
+                // name the file, else the rank, else both, when another piece of the kind can go there too
+                bool ambiguous = false;
+                bool sameFile = false;
+                bool sameRank = false;
+                for (const Move& other : board.generateLegalMoves()) {
+                    if (other.pieceType != move.pieceType || other.to != move.to || other.from == move.from) continue;
+                    ambiguous = true;
+                    sameFile |= getFile(other.from) == getFile(move.from);
+                    sameRank |= getRank(other.from) == getRank(move.from);
+                }
+                if (ambiguous && (!sameFile || sameRank)) san += (char) ('a' + getFile(move.from));
+                if (ambiguous && sameFile) san += (char) ('1' + getRank(move.from));
+            }
+
+            if (capture) san += 'x';
+            san += indexToPrettyString(move.to);
+            if (isValidPiece(move.promotionType)) {
+                san += '=';
+                san += PIECE_LETTERS[move.promotionType];
+            }
+        }
+
+        Board after(board);
+        after.makeMove(move);
+        if (after.bitboards[them][KING] & after.getAttacks(board.state.activeColor)) {
+            san += after.generateLegalMoves().size() == 0 ? '#' : '+';
+        }
+        return san;
+    }
+
+    bool nextGame(std::string_view& text, Game& game) {
+        game.tags.clear();
+        game.movetext = {};
+        game.result = {};
+        game.plies = 0;
+        game.error = nullptr;
+
+        // blank lines and % escapes before the game
+        while (true) {
+            text = text.substr(std::min(text.find_first_not_of(SPACE), text.size()));
+            if (text.empty()) return false;
+            if (text.front() != '%') break;
+            skipLine(text);
+        }
+        std::string_view start = text;
+
+        Tag tag;
+        while (!text.empty() && text.front() == '[') {
+            if (parseTag(text.substr(0, text.find('\n')), tag)) game.tags.push_back(tag);
+            skipLine(text);
+            text = text.substr(std::min(text.find_first_not_of(SPACE), text.size()));
+        }
+
+        // the movetext runs up to its result, or up to the next game's tags when the result is missing
+        size_t i = 0;
+        size_t end = 0;
+        while (i < text.size()) {
+            char c = text[i];
+            if (c == '{' || c == ';') {
+                i = std::min(text.find(c == '{' ? '}' : '\n', i), text.size());
+                continue;
+            }
+            if (c == '[' && i > 0 && text[i - 1] == '\n') break;
+            if (SPACE.find(c) != std::string_view::npos || c == '}' || c == '(' || c == ')') {
+                i++;
+                continue;
+            }
+
+            size_t tokenEnd = std::min(text.find_first_of(" \t\r\n{}();", i), text.size());
+            std::string_view token = text.substr(i, tokenEnd - i);
+            i = end = tokenEnd;
+            if (isResult(token)) {
+                game.result = token;
+                break;
+            }
+        }
+
+        game.movetext = text.substr(0, end);
+        game.text = start.substr(0, start.size() - text.size() + end);
+        text = text.substr(i);
+
+        if (game.result.empty()) game.result = game.tag("Result").value_or("*");
+        return true;
+    }
+
+    void replay(Game& game, Visitor& visitor) {
+        game.plies = 0;
+        game.error = nullptr;
+
+        Board board;
+        if (!board.loadFen(game.tag("FEN").value_or(STARTING_POS), &game.error)) {
+            visitor.endGame(game, board);
+            return;
+        }
+
+        // a move is handed to the visitor once the comment after it is known
+        std::optional<Move> pending;
+        std::string_view comment;
+        auto flush = [&]() {
+            if (!pending) return;
+            visitor.position(game, board, *pending, comment);
+            board.makeMove(*pending);
+            game.plies++;
+            pending.reset();
+            comment = {};
+        };
+
+        std::string_view text = game.movetext;
+        int variationDepth = 0;
+        while (!text.empty()) {
+            char c = text.front();
+            if (c == '{' || c == ';') {
+                size_t end = std::min(text.find(c == '{' ? '}' : '\n'), text.size());
+                if (variationDepth == 0 && comment.empty()) comment = util::trim(text.substr(1, end - 1));
+                text = text.substr(std::min(end + 1, text.size()));
+                continue;
+            }
+            if (c == '(' || c == ')') {
+                variationDepth = std::max(variationDepth + (c == '(' ? 1 : -1), 0);
+                text.remove_prefix(1);
+                continue;
+            }
+            if (SPACE.find(c) != std::string_view::npos || c == '}') {
+                text.remove_prefix(1);
+                continue;
+            }
+
+            size_t end = std::min(text.find_first_of(" \t\r\n{}();"), text.size());
+            std::string_view token = text.substr(0, end);
+            text.remove_prefix(end);
+            if (variationDepth > 0 || token.front() == '$' || isResult(token)) continue;
+
+            // move numbers, alone ("12." or "12...") or stuck to the move ("12.e4")
+            size_t digits = token.find_first_not_of("0123456789");
+            if (digits == std::string_view::npos) continue;
+            if (token[digits] == '.') {
+                token.remove_prefix(digits);
+                token.remove_prefix(std::min(token.find_first_not_of('.'), token.size()));
+                if (token.empty()) continue;
+            }
+
+            flush();
+            pending = sanToMove(board, token);
+            if (!pending) {
+                game.error = "illegal or ambiguous move";
+                break;
+            }
+        }
+
+        flush();
+        visitor.endGame(game, board);
+    }
+
+    size_t forEachGame(std::string_view text, Visitor& visitor) {
+        Game game;
+        size_t games = 0;
+        while (nextGame(text, game)) {
+            games++;
+            if (visitor.startGame(game)) replay(game, visitor);
+        }
+        return games;
+    }
+
+    std::vector<std::string_view> splitGames(std::string_view text, size_t parts) {
+        std::vector<std::string_view> pieces;
+        size_t start = 0;
+        for (size_t i = 1; i < parts; i++) {
+            size_t cut = text.find("\n[Event ", std::max(text.size() / parts * i, start));
+            if (cut == std::string_view::npos) break;
+            pieces.push_back(text.substr(start, cut + 1 - start));
+            start = cut + 1;
+        }
+        pieces.push_back(text.substr(start));
+        return pieces;
+    }
+} // namespace choco::pgn
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "types.h"
+
+namespace choco::pgn {
+    struct Tag {
+        std::string_view name;
+        std::string_view value; // without the quotes; escapes are left as they are
+    };
+
+    // One game of a PGN file. The views point into the parsed text, usually a MappedFile, and the
+    // tag vector is reused from game to game, so reading a database doesn't allocate per game.
+    struct Game {
+        std::vector<Tag> tags;
+        std::string_view movetext;
+        std::string_view text;   // the whole game, tags included
+        std::string_view result; // "1-0", "0-1", "1/2-1/2" or "*"; from the Result tag if the movetext has none
+        size_t plies = 0;             // main-line moves played by replay
+        const char* error = nullptr;  // why replay stopped before the end of the movetext
+
+        std::optional<std::string_view> tag(std::string_view name) const;
+    };
+
+    class Visitor {
+    public:
+        virtual ~Visitor() = default;
+
+        // the tags are read; returning false skips the moves and endGame
+        virtual bool startGame(const Game& /* game */) {
+            return true;
+        }
+        // every main-line move with the position before it, and the first comment after the move
+        virtual void position(const Game& /* game */, const Board& /* board */, const Move& /* move */,
+                              std::string_view /* comment */) { }
+        // the position after the last move, or the last good one when game.error is set
+        virtual void endGame(const Game& /* game */, const Board& /* board */) { }
+    };
+
+    // the legal move written in standard algebraic notation, e.g. "Nbd7", "exd6", "e8=Q+" or "O-O".
+    // nullopt if the text matches no legal move or several. Check marks and "!?" are ignored, and
+    // 0-0, a missing '=' before the promotion piece and long forms like "Ng1-f3" are accepted
+    std::optional<Move> sanToMove(const Board& board, std::string_view san);
+
+    // a legal move in standard algebraic notation, with a check or mate mark
+    std::string moveToSan(const Board& board, const Move& move);
+
+    // pops the next game off the front of text and reads its tags. Text before the first tag,
+    // such as % escape lines, is skipped. false once text holds no more games
+    bool nextGame(std::string_view& text, Game& game);
+
+    // plays the main line of the movetext from the FEN tag or the starting position, skipping
+    // move numbers, NAGs and variations. Sets game.plies and game.error
+    void replay(Game& game, Visitor& visitor);
+
+    // nextGame and replay over every game in text; returns the number of games read
+    size_t forEachGame(std::string_view text, Visitor& visitor);
+
+    // cuts text into at most parts pieces of similar size for separate threads. Each piece but the
+    // first starts at an [Event tag at the beginning of a line, so no game is split
+    std::vector<std::string_view> splitGames(std::string_view text, size_t parts);
+} // namespace choco::pgn
@@ -2,7 +2,6 @@
 
 #include <limits>
 #include <algorithm>
-#include <random>
 #include <string>
 #include <iostream>
 #include <cmath>
@@ -11,150 +10,57 @@
 #include <atomic>
 #include <cstring>
 #include <algorithm>
-
-#ifdef BOT_PERF_CTR
 #include <chrono>
-#endif
 
 #include "macros.h"
 #include "bithelpers.h"
 #include "eval.h"
+#include "tablebase.h"
 #include "uci.h"
 
 namespace choco {
     namespace {
-#ifdef BOT_PERF_CTR
         int64_t getCurrentMs() {
-            auto now = std::chrono::system_clock::now();
+            auto now = std::chrono::steady_clock::now();
             auto duration = now.time_since_epoch();
             return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
         }
-#endif
-    }
-
-    static uint64_t TRANSPOSITION_HASHES[15][64] = {0};
-
-    void initTT() {
-        std::mt19937_64 engine(670);
-        for (size_t i = 0; i < 15; i++) {
-            for (size_t j = 0; j < 64; j++) {
-                TRANSPOSITION_HASHES[i][j] = engine();
-            }
-        }
     }
 
     static constexpr float MATE_EVAL = 32000;
     static constexpr float MATE_EVAL_THRESHOLD = 30000;
+    static constexpr float INFINITE_EVAL = 9999999999999;
 
-    inline TTEntry& Search::tt_probe(uint64_t key) {
-        return TT[key & TT_MASK];
-    }
+    // tablebase wins rank above any static eval but below mates found by the search
+    static constexpr float TB_WIN_EVAL = 1000;
 
-    inline void Search::tt_store(uint64_t key, float eval, int depth, TTFlag flag, const Move& bestMove) {
-        TTEntry& e = tt_probe(key);
-        if (e.key != key || depth >= e.depth) {
-            e.key = key;
-            e.eval = eval;
-            e.depth = depth;
-            e.flag = flag;
-            e.bestMove = bestMove;
-        }
-    }
-
-    inline bool Search::tt_lookup(uint64_t key, TTEntry& out, int requiredDepth) {
-        TTEntry& e = tt_probe(key);
-        if (e.key == key && e.depth >= requiredDepth) {
-            out = e;
-            return true;
-        }
-        return false;
-    }
-
-    uint64_t getHash(const Board& board) {
-        uint64_t hash = 0;
-
-        for (int color = 0; color < 2; color++) {
-            for (int p = 0; p < 6; p++) {
-                uint64_t bb = board.bitboards[color][p];
-                while (bb) {
-                    uint8_t idx = countTrailingZeros(bb);
-                    bb &= bb - 1;
-                    int hashIdx = p + (color * 6);
-                    hash ^= TRANSPOSITION_HASHES[hashIdx][idx];
-                }
-            }
-        }
+    // evals are whole centipawns, so a window one centipawn wide only asks whether a move beats alpha
+    static constexpr float NULL_WINDOW = 0.01f;
 
-        hash ^= TRANSPOSITION_HASHES[12][board.state.activeColor];
+    // reverse futility pruning only trusts the static eval this close to the leaves
+    static constexpr int REVERSE_FUTILITY_DEPTH = 3;
 
-        if (board.state.canCastle(SIDE_WHITE, KING))  hash ^= TRANSPOSITION_HASHES[13][0];
-        if (board.state.canCastle(SIDE_WHITE, QUEEN)) hash ^= TRANSPOSITION_HASHES[13][1];
-        if (board.state.canCastle(SIDE_BLACK, KING))  hash ^= TRANSPOSITION_HASHES[13][2];
-        if (board.state.canCastle(SIDE_BLACK, QUEEN)) hash ^= TRANSPOSITION_HASHES[13][3];
+    // only report the move being searched at the root once the search has run for a while
+    static constexpr int64_t CURRMOVE_DELAY_MS = 1000;
 
-        if (IS_VALID_SQUARE(board.state.enpassantSquare)) {
-            hash ^= TRANSPOSITION_HASHES[14][getFile(board.state.enpassantSquare)];
-        }
-
-        return hash;
-    }
-
-    uint64_t getHash(const Board& board, const Move& nextMove) {
-        uint64_t hash = getHash(board);
-
-        hash ^= TRANSPOSITION_HASHES[nextMove.pieceType][nextMove.from];
-        hash ^= TRANSPOSITION_HASHES[nextMove.pieceType][nextMove.to];
-
-        uint8_t capturedPiece = getPieceOnSquare(
-                                board.bitboards[OPPOSITE_SIDE(board.state.activeColor)],
-                                nextMove.to);
-        if (capturedPiece != INVALID_PIECE) {
-            hash ^= TRANSPOSITION_HASHES[capturedPiece][nextMove.to];
-        }
-
-        hash ^= TRANSPOSITION_HASHES[12][board.state.activeColor];
-        hash ^= TRANSPOSITION_HASHES[12][OPPOSITE_SIDE(board.state.activeColor)];
-
-        if (nextMove.pieceType == KING && (nextMove.from == E1 || nextMove.from == E8)
-            && (board.state.canCastle(board.state.activeColor, KING)
-                || board.state.canCastle(board.state.activeColor, KING))) { // disable castling
-            hash ^= TRANSPOSITION_HASHES[13][0 + 2 * board.state.activeColor];
-            hash ^= TRANSPOSITION_HASHES[13][1 + 2 * board.state.activeColor];
-        }
-
-        if ((nextMove.from == A1 || nextMove.to == A1) && board.state.canCastle(SIDE_WHITE, KING))
-            hash ^= TRANSPOSITION_HASHES[13][0];
-        if ((nextMove.from == H1 || nextMove.to == H1) && board.state.canCastle(SIDE_WHITE, QUEEN))
-            hash ^= TRANSPOSITION_HASHES[13][1];
-        if ((nextMove.from == A8 || nextMove.to == A8) && board.state.canCastle(SIDE_BLACK, KING))
-            hash ^= TRANSPOSITION_HASHES[13][2];
-        if ((nextMove.from == H8 || nextMove.to == H8) && board.state.canCastle(SIDE_BLACK, QUEEN))
-            hash ^= TRANSPOSITION_HASHES[13][3];
-        
-        // undo getHash(Board&), since the en passant square has changed
-        if (IS_VALID_SQUARE(board.state.enpassantSquare)) {
-            hash ^= TRANSPOSITION_HASHES[14][getFile(board.state.enpassantSquare)];
-        }
-
-        // double push (en passant)
-        if (nextMove.pieceType == PAWN && unsignedDist(nextMove.from, nextMove.to) == 16) {
-            hash ^= TRANSPOSITION_HASHES[15][getFile(nextMove.from)];
-        }
-
-        return hash;
+    inline void Search::countNode() {
+        uint64_t n = nodes.load(std::memory_order_relaxed) + 1;
+        nodes.store(n, std::memory_order_relaxed);
+        if ((n & 1023) == 0) checkTime();
     }
 
-    int nodes = 0;
-
     inline float exchangeVal(Board& board, const Move& move) {
-        uint8_t capturedPiece = getPieceOnSquare(board.bitboards[board.state.activeColor], move.to);
+        uint8_t capturedPiece = getPieceOnSquare(board.bitboards[OPPOSITE_SIDE(board.state.activeColor)], move.to);
         return isValidPiece(capturedPiece) ? STATIC_PIECE_VALUES[capturedPiece] - STATIC_PIECE_VALUES[move.pieceType] : 0;
     }
 
     inline float Search::quiesce(Board& board, float alpha, float beta) {
-        if (!searching.load()) return std::numeric_limits<float>::quiet_NaN();
+        if (!searching.load(std::memory_order_relaxed)) return std::numeric_limits<float>::quiet_NaN();
+        countNode();
+
+        STATS_INC(stats, qsNodes);
 
-        float stand = evaluate(board);
+        float stand = evaluate(board, pawnTable, evalCache);
         if (stand >= beta) return stand;
         if (stand > alpha) alpha = stand;
 
@@ -162,9 +68,9 @@ namespace choco {
         uint64_t oppPieces = board.occupiedSquares[OPPOSITE_SIDE(board.state.activeColor)];
 
         for (int i = 1; i < moves.size(); i++) {
-            const Move& keyMove = moves[i];
+            const Move keyMove = moves[i];
             float key = exchangeVal(board, keyMove);
-            float j = i - 1;
+            int j = i - 1;
 
             while (j >= 0 && exchangeVal(board, moves[j]) < key) {
                 moves[j + 1] = moves[j];
@@ -186,17 +92,19 @@ namespace choco {
             if (!u.isValid()) continue;
 
             float score = -quiesce(board, -beta, -alpha);
-            if (std::isnan(score)) return std::numeric_limits<float>::quiet_NaN();
-            nodes++;
             board.unmakeMove(u);
+            if (std::isnan(score)) return std::numeric_limits<float>::quiet_NaN();
 
             if (score >= beta) return score;
 
             // delta pruning
-            float delta = STATIC_PIECE_VALUES[QUEEN];
-            if (isValidPiece(m.promotionType)) delta *= 2;
-            if (score < (alpha - delta)) {
-                return alpha;
+            if (options.deltaPruning) {
+                float delta = options.params.deltaMargin / 100.f;
+                if (isValidPiece(m.promotionType)) delta *= 2;
+                if (score < (alpha - delta)) {
+                    STATS_INC(stats, deltaPrunes);
+                    return alpha;
+                }
             }
 
             if (score > alpha) alpha = score;
@@ -205,68 +113,157 @@ namespace choco {
         return alpha;
     }
 
-#ifdef BOT_PERF_CTR
-    int64_t lastAnalysisMs = 0;
-#endif // BOT_PERF_CTR
+    template<NodeType node>
+    float Search::negamax(Board& board, float alpha, float beta, int depth, int ply) {
+        constexpr bool pvNode = node != NodeType::NON_PV;
+        constexpr bool rootNode = node == NodeType::ROOT;
+
+        if (!searching.load(std::memory_order_relaxed)) return std::numeric_limits<float>::quiet_NaN();
+        countNode();
+
+        if constexpr (pvNode) pvLength[ply] = ply;
 
-    float Search::negamax(Board& board, float alpha, float beta, int depth) {
-        if (!searching.load(std::memory_order_acquire)) return std::numeric_limits<double>::quiet_NaN();
-        
         if (depth <= 0) return quiesce(board, alpha, beta);
 
-#ifdef BOT_PERF_CTR
-        if (getCurrentMs() - lastAnalysisMs > 1000) {
-            lastAnalysisMs = getCurrentMs();
-            std::cout << "info nps " << std::to_string(nodes) << std::endl;
-            nodes = 0;
+        if constexpr (!rootNode) {
+            if (isRepetition(board) || board.state.halfMoveClock >= 100) return 0;
+
+            // tablebases and the bitbase already know the result; no need to search the subtree
+            uint64_t occupied = board.occupiedSquares[SIDE_WHITE] | board.occupiedSquares[SIDE_BLACK];
+            if (countOnes(occupied) <= tb::maxPieces()) {
+                if (std::optional<int8_t> wdl = tb::probeWdl(board)) {
+                    // sooner wins are better, so the search still makes progress towards them
+                    return *wdl == tb::DRAW ? 0 : (*wdl > 0 ? TB_WIN_EVAL - ply : -TB_WIN_EVAL + ply);
+                }
+            }
+            if (kpk::isKpk(board)) return evaluate(board, pawnTable, evalCache);
         }
-#endif // BOT_PERF_CTR
 
-        uint64_t key = getHash(board);
+        STATS_INC(stats, mainNodes);
+        STATS_INC_AT(stats, depthNodes, depth);
+
+        uint64_t key = board.key;
+        const float originalAlpha = alpha;
 
         TTEntry entry;
-        if (tt_lookup(key, entry, depth)) {
-            if (entry.flag == TT_EXACT) return entry.eval;
-            if (entry.flag == TT_ALPHA && entry.eval <= alpha) return alpha;
-            if (entry.flag == TT_BETA  && entry.eval >= beta)  return beta;
+        STATS_INC(stats, ttProbes);
+        bool ttFound = tt->lookup(key, entry);
+        if (ttFound && entry.depth >= depth) {
+            STATS_INC(stats, ttHits);
+
+            // PV nodes always search, so the PV table stays complete
+            if constexpr (!pvNode) {
+                if (entry.flag == TT_EXACT
+                    || (entry.flag == TT_ALPHA && entry.eval <= alpha)
+                    || (entry.flag == TT_BETA  && entry.eval >= beta)) {
+                    STATS_INC(stats, ttCutoffs);
+                }
+
+                if (entry.flag == TT_EXACT) return entry.eval;
+                if (entry.flag == TT_ALPHA && entry.eval <= alpha) return alpha;
+                if (entry.flag == TT_BETA  && entry.eval >= beta)  return beta;
+            }
+        }
+
+        // the slot was just probed, so its static eval is free; otherwise it is computed when needed
+        float staticEval = ttFound ? entry.staticEval : NO_STATIC_EVAL;
+
+        // reverse futility pruning: far enough above beta that a shallow search won't come back down
+        if constexpr (!pvNode) {
+            if (options.reverseFutility && depth <= REVERSE_FUTILITY_DEPTH && std::abs(beta) < TB_WIN_EVAL - MAX_PLY
+                && !(board.bitboards[board.state.activeColor][KING] & board.getAttacks(OPPOSITE_SIDE(board.state.activeColor)))) {
+                if (staticEval == NO_STATIC_EVAL) staticEval = evaluate(board, pawnTable, evalCache);
+                if (staticEval - depth * options.params.futilityMargin / 100.f >= beta) {
+                    STATS_INC(stats, futilityPrunes);
+                    return staticEval;
+                }
+            }
         }
 
         float best = -MATE_EVAL;
         Move bestMove;
 
-        MoveList moves = board.generatePLMoves();
-
-        orderMoves(board, key, moves);
+        MoveList moves;
+        if constexpr (rootNode) {
+            moves = rootMoves;
+        } else {
+            moves = board.generatePLMoves();
+            orderMoves(board, key, moves);
+        }
         
         bool invalidMove = true;
 
         int movesLooked = 0;
         // obsidian lmr formula
-        const int lmrCutoff = (int)(0.99 + std::log(depth) * std::log(moves.size()) / 3.14);
+        const int lmrCutoff = (int)(options.params.lmrBase / 100.0
+                                    + std::log(depth) * std::log(moves.size()) / (options.params.lmrDivisor / 100.0));
 
         for (const Move& m : moves) {
-            bool shouldReduce = (movesLooked++ >= lmrCutoff && depth > 2);
+            bool shouldReduce = (movesLooked++ >= lmrCutoff && depth > 2 && options.lateMoveReductions);
 
             UnmakeMove u = board.makeMove(m);
             if (!u.isValid()) continue;
+            keyHistory.push_back(board.key);
 
+            bool firstMove = invalidMove;
             invalidMove = false;
-            
-            float score = -negamax(board, -beta, -alpha, depth - 1 - 1 * shouldReduce);
 
-            if (std::isnan(score)) return score;
+            if constexpr (rootNode) {
+                if (threadIndex == 0 && options.uciOutput && getCurrentMs() - startMs >= CURRMOVE_DELAY_MS) {
+                    std::cout << "info depth " << depth << " currmove " << moveToUci(m)
+                              << " currmovenumber " << movesLooked << std::endl;
+                }
+            }
+
+            float score;
+            if (firstMove) {
+                score = -negamax<pvNode ? NodeType::PV : NodeType::NON_PV>(board, -beta, -alpha, depth - 1, ply + 1);
+            } else {
+                // every later move only has to be proven worse than alpha, which a null window does cheaply
+                score = -negamax<NodeType::NON_PV>(board, -alpha - NULL_WINDOW, -alpha, depth - 1 - 1 * shouldReduce, ply + 1);
+
+                if (shouldReduce && !std::isnan(score)) {
+                    STATS_INC(stats, lmrReductions);
+                    STATS_INC_AT(stats, depthReductions, depth);
+
+                    // reduced search beat alpha; verify at full depth
+                    if (score > alpha) {
+                        STATS_INC(stats, lmrResearches);
+                        score = -negamax<NodeType::NON_PV>(board, -alpha - NULL_WINDOW, -alpha, depth - 1, ply + 1);
+                    }
+                }
+
+                // the move may be inside the window; find its exact score
+                if (pvNode && score > alpha && score < beta) {
+                    score = -negamax<NodeType::PV>(board, -beta, -alpha, depth - 1, ply + 1);
+                }
+            }
 
+            keyHistory.pop_back();
             board.unmakeMove(u);
 
+            if (std::isnan(score)) return score;
+
             if (score > best) {
                 best = score;
                 bestMove = m;
             }
-            if (score > alpha) alpha = score;
+            if (score > alpha) {
+                alpha = score;
+
+                if constexpr (pvNode) {
+                    pvTable[ply][ply] = m;
+                    for (int i = ply + 1; i < pvLength[ply + 1]; i++) pvTable[ply][i] = pvTable[ply + 1][i];
+                    pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+                }
+            }
 
             if (score >= beta) {
-                tt_store(key, best, depth, TTFlag::TT_BETA, m);
-                nodes++;
+                STATS_INC(stats, betaCutoffs);
+                STATS_INC_AT(stats, depthCutoffs, depth);
+                if (firstMove) STATS_INC(stats, firstMoveCutoffs);
+
+                tt->store(key, best, staticEval, depth, TTFlag::TT_BETA, m);
                 return best;
             }
         }
@@ -286,17 +283,55 @@ namespace choco {
             best++;
         }
 
-        TTFlag flag = (best <= alpha ? TTFlag::TT_ALPHA : TTFlag::TT_EXACT);
-        tt_store(key, best, depth, flag, bestMove);
+        TTFlag flag = (best <= originalAlpha ? TTFlag::TT_ALPHA : TTFlag::TT_EXACT);
+        tt->store(key, best, staticEval, depth, flag, bestMove);
 
         return best;
     }
 
 
-    Search::Search(const Board& board) : board(board), depthSoFar(0), searching(false),
-            bestMove(bestMove = { INVALID_PIECE, INVALID_SQUARE, INVALID_SQUARE, INVALID_PIECE }) {
-        TT = new TTEntry[TT_SIZE];
-        clearTT();
+    Search::Search(const Board& board) : Search(board, std::make_shared<TranspositionTable>(), 0) { }
+
+    Search::Search(const Board& board, std::shared_ptr<TranspositionTable> tt, int threadIndex)
+            : board(board), bestMove({ INVALID_PIECE, INVALID_SQUARE, INVALID_SQUARE, INVALID_PIECE }), bestEval(0), bestDepth(0),
+              depthSoFar(0), maxDepth(0), nodeLimit(0), searching(false), threadIndex(threadIndex),
+              nodes(0), deadline(0), startMs(0), lastReportMs(0), lastReportNodes(0),
+              tt(std::move(tt)), pvLength(), bestPvLength(0) {
+        keyHistory.reserve(MAX_HISTORY);
+        keyHistory.push_back(board.key);
+    }
+
+    bool Search::isRepetition(const Board& board) const {
+        // keyHistory.back() is the current position; only positions with the same side to move
+        // since the last capture or pawn move can repeat
+        int current = (int) keyHistory.size() - 1;
+        int oldest = std::max(0, current - board.state.halfMoveClock);
+
+        for (int i = current - 2; i >= oldest; i -= 2) {
+            if (keyHistory[i] == board.key) return true;
+        }
+
+        return false;
+    }
+
+    float Search::getEval() const {
+        return bestEval;
+    }
+
+    UciScore Search::getUciScore() const {
+        if (std::abs(bestEval) < MATE_EVAL_THRESHOLD) return { false, (int) (bestEval * 100) };
+
+        // plies until the mate
+        int plies = (int) std::lround(MATE_EVAL - std::abs(bestEval));
+        return { true, bestEval > 0 ? (plies + 1) / 2 : -(plies / 2) };
+    }
+
+    std::vector<Move> Search::getPv() const {
+        return std::vector<Move>(bestPv, bestPv + bestPvLength);
+    }
+
+    int Search::getDepth() const {
+        return bestDepth;
     }
 
     const Board& Search::getBoard() const {
@@ -304,58 +339,207 @@ namespace choco {
     }
 
     void Search::search(const SearchBounds& bound) {
-        float bestEval = -9999999999999;
+        int64_t now = getCurrentMs();
+        deadline = now + bound.moveTime;
+        startMs = now;
+        maxDepth = bound.depth;
+        nodeLimit = bound.nodes;
+        lastReportMs = now;
+        lastReportNodes = 0;
+
+        // counters are per thread, so each thread samples its own search
+        auto run = [](Search& search) {
+#ifdef BOT_PERF_COUNTERS
+            PerfCounters counters;
+            counters.start();
+            search.iterate();
+            search.perfSample = counters.stop();
+#else
+            search.iterate();
+#endif
+        };
+
+        // every thread is marked as searching before any starts, so the stop below can't be lost
+        // to a helper that hasn't reached iterate() yet
         searching.store(true);
+        std::vector<std::thread> threads;
+        threads.reserve(helpers.size());
+        for (auto& helper : helpers) {
+            helper->board = board;
+            helper->keyHistory = keyHistory;
+            helper->options = options;
+            helper->maxDepth = bound.depth;
+            helper->nodeLimit = bound.nodes;
+            helper->searching.store(true);
+            threads.emplace_back([&run, &helper]() { run(*helper); });
+        }
 
-        std::thread watcherThread([&]() -> void {
-            std::this_thread::sleep_for(std::chrono::milliseconds(bound.moveTime));
-            searching.store(false);
-        });
-        watcherThread.detach();
+        run(*this);
 
-        
-        while (true) {
+        for (auto& helper : helpers) helper->stop();
+        for (std::thread& thread : threads) thread.join();
+
+#ifdef BOT_PERF_COUNTERS
+        for (const auto& helper : helpers) perfSample += helper->perfSample;
+#endif
+        if (!options.uciOutput) return;
+
+#ifdef BOT_SEARCH_STATS
+        std::cout << stats.toString() << std::endl;
+#endif
+#ifdef BOT_PERF_COUNTERS
+        std::cout << perfSample.toString(getNodes()) << std::endl;
+#endif
+        std::cout << "bestmove " << moveToUci(bestMove) << std::endl;
+    }
+
+    void Search::iterate() {
+        bestEval = 0;
+        bestDepth = 0;
+        bestPvLength = 0;
+        nodes.store(0, std::memory_order_relaxed);
+        // helpers start at staggered depths so the threads don't all search the same tree
+        depthSoFar = threadIndex % 2;
+
+#ifdef BOT_SEARCH_STATS
+        stats.clear();
+#endif
+
+        bestMove = { INVALID_PIECE, INVALID_SQUARE, INVALID_SQUARE, INVALID_PIECE };
+
+        rootMoves = board.generateLegalMoves();
+        if (rootMoves.size() == 0 || probeRoot()) return;
+        orderMoves(board, board.key, rootMoves);
+
+        while (depthSoFar < MAX_PLY - 2) {
             depthSoFar++;
 
-            float depthBestEval = -9999999999999;
-            Move depthBestMove = { INVALID_PIECE, INVALID_SQUARE, INVALID_SQUARE, INVALID_PIECE };
-            MoveList moves = board.generatePLMoves();
-
-            for (const Move& move : moves) {
-                UnmakeMove unmake = board.makeMove(move);
-                if (!unmake.isValid()) continue;
-
-                float eval = -negamax(board,
-                                      -9999999999999,
-                                      9999999999999,
-                                      depthSoFar);
-                if (std::isnan(eval) || !searching) {
-                    std::cout << "bestmove " << moveToUci(bestMove) << std::endl;
-                    return;
-                }
+            float eval = negamax<NodeType::ROOT>(board, -INFINITE_EVAL, INFINITE_EVAL, depthSoFar, 0);
+
+            // a root move that beat alpha is better than last iteration's choice even if the search
+            // was stopped afterwards
+            if (pvLength[0] > 0) bestMove = pvTable[0][0];
+
+            if (std::isnan(eval) || !searching) {
+                // stopped before any root move was searched in the first iteration
+                if (!isValidPiece(bestMove.pieceType)) bestMove = rootMoves[0];
+                return;
+            }
 
-                board.unmakeMove(unmake);
+            bestEval = eval;
+            bestDepth = depthSoFar;
+            bestPvLength = pvLength[0];
+            std::copy(pvTable[0], pvTable[0] + pvLength[0], bestPv);
 
-                if (eval > depthBestEval) {
-                    depthBestEval = eval;
-                    depthBestMove = move;
+            // the next iteration searches the best move first
+            for (uint8_t i = 0; i < rootMoves.size(); i++) {
+                if (rootMoves[i] == bestMove) {
+                    rootMoves.swap(0, i);
+                    break;
                 }
             }
 
-            bestEval = depthBestEval;
-            bestMove = depthBestMove;
+#ifdef BOT_SEARCH_STATS
+            stats.endIteration();
+#endif
 
-            std::cout << "info depth " << std::to_string(depthSoFar) << " ";
+            if (threadIndex == 0 && options.uciOutput) {
+                std::cout << "info depth " << std::to_string(depthSoFar) << " ";
 
-            if (std::abs(bestEval) >= MATE_EVAL_THRESHOLD) {
-                int mateIn = MATE_EVAL - std::abs(bestEval);
-                std::cout << "score mate " << std::to_string(mateIn / 2 + 1) << " ";
-            } else {
-                std::cout << "score cp " << std::to_string((int)(bestEval * 100)) << " ";
+                UciScore score = getUciScore();
+                std::cout << "score " << (score.mate ? "mate " : "cp ") << score.value << " ";
+
+                std::cout << "pv";
+                for (int i = 0; i < pvLength[0]; i++) std::cout << " " << moveToUci(pvTable[0][i]);
+                std::cout << std::endl;
+            }
+
+            // helpers stop at the depth limit too, rather than waiting for the main thread
+            if (maxDepth > 0 && depthSoFar >= maxDepth) return;
+        }
+    }
+
+    bool Search::probeRoot() {
+        uint64_t occupied = board.occupiedSquares[SIDE_WHITE] | board.occupiedSquares[SIDE_BLACK];
+        if (countOnes(occupied) > tb::maxPieces()) return false;
+
+        // plies until our mate (positive) or until we're mated (negative); 0 for draws
+        int bestPlies = 0;
+        int bestScore = std::numeric_limits<int>::min();
+
+        for (const Move& move : rootMoves) {
+            UnmakeMove unmake = board.makeMove(move);
+            std::optional<int8_t> dtm = tb::probeDtm(board);
+            board.unmakeMove(unmake);
+            if (!dtm) return false;
+
+            // the value is the opponent's, one ply later
+            int plies = *dtm == tb::DRAW ? 0 : (*dtm < 0 ? 1 : -1) * (tb::pliesToMate(*dtm) + 1);
+            // quickest win, then a draw, then the slowest loss
+            int score = plies > 0 ? 1000 - plies : (plies < 0 ? -1000 - plies : 0);
+            if (score > bestScore) {
+                bestScore = score;
+                bestPlies = plies;
+                bestMove = move;
             }
-            std::cout << "pv " << moveToUci(bestMove) << std::endl;
         }
+
+        bestEval = bestPlies == 0 ? 0 : (bestPlies > 0 ? MATE_EVAL - bestPlies : -MATE_EVAL - bestPlies);
+        bestDepth = 1;
+        bestPvLength = 1;
+        bestPv[0] = bestMove;
+
+        if (threadIndex == 0 && options.uciOutput) {
+            UciScore score = getUciScore();
+            std::cout << "info depth 1 score " << (score.mate ? "mate " : "cp ") << score.value
+                      << " pv " << moveToUci(bestMove) << std::endl;
+        }
+
+        return true;
+    }
+
+    void Search::checkTime() {
+        // the main thread owns the clock and stops the helpers once it's done; a helper only
+        // stops itself when it alone has used up the node limit
+        if (threadIndex != 0) {
+            if (nodeLimit > 0 && nodes.load(std::memory_order_relaxed) >= nodeLimit) searching.store(false);
+            return;
+        }
+
+        int64_t now = getCurrentMs();
+
+#ifdef BOT_SEARCH_STATS
+        if (options.uciOutput && now - lastReportMs > 1000) {
+            uint64_t totalNodes = nodes.load(std::memory_order_relaxed);
+            for (const auto& helper : helpers) totalNodes += helper->nodes.load(std::memory_order_relaxed);
+
+            std::cout << "info nps " << std::to_string((totalNodes - lastReportNodes) * 1000 / (now - lastReportMs)) << std::endl;
+            lastReportMs = now;
+            lastReportNodes = totalNodes;
+        }
+#endif // BOT_SEARCH_STATS
+
+        if (now >= deadline) searching.store(false);
+        // checked every 1024 nodes, so a single thread stops at the same node count every time
+        if (nodeLimit > 0 && getNodes() >= nodeLimit) searching.store(false);
+    }
+
+    uint64_t Search::getNodes() const {
+        uint64_t total = nodes.load(std::memory_order_relaxed);
+        for (const auto& helper : helpers) total += helper->nodes.load(std::memory_order_relaxed);
+        return total;
+    }
+
+#ifdef BOT_SEARCH_STATS
+    const SearchStats& Search::getStats() const {
+        return stats;
+    }
+#endif
+#ifdef BOT_PERF_COUNTERS
+    const PerfSample& Search::getPerfSample() const {
+        return perfSample;
     }
+#endif
 
     void Search::stop() {
         searching.store(false);
@@ -367,12 +551,32 @@ namespace choco {
 
     void Search::playMove(const Move& move) {
         board.makeMove(move);
+        keyHistory.push_back(board.key);
         bestMove = { INVALID_PIECE, INVALID_SQUARE, INVALID_SQUARE, INVALID_PIECE };
         depthSoFar = 0;
     }
 
     void Search::clearTT() {
-        std::fill(TT, TT + TT_SIZE, TTEntry());
+        tt->clear();
+        pawnTable.clear();
+        evalCache.clear();
+        for (auto& helper : helpers) {
+            helper->pawnTable.clear();
+            helper->evalCache.clear();
+        }
+    }
+
+    void Search::setThreads(int threads) {
+        size_t helperCount = std::max(threads, 1) - 1;
+
+        helpers.resize(std::min(helperCount, helpers.size()));
+        while (helpers.size() < helperCount) {
+            helpers.emplace_back(new Search(board, tt, (int) helpers.size() + 1));
+        }
+    }
+
+    void Search::setHashSize(size_t megabytes) {
+        tt->resize(megabytes);
     }
 
     inline void Search::orderMoves(Board& board, uint64_t boardHash, MoveList& moves) {
@@ -380,7 +584,7 @@ namespace choco {
         // TTPV move
         TTEntry entry;
         bool lookupFound = false;
-        if (tt_lookup(boardHash, entry, 0)) {
+        if (tt->lookup(boardHash, entry)) {
             for (uint8_t i = 0; i < moves.size(); i++) {
                 if (entry.bestMove == moves[i]) {
                     moves.swap(0, i);
@@ -392,12 +596,13 @@ namespace choco {
 
         // insertion sort
         // MVV/LVA
-        for (int i = (lookupFound ? 1 : 2); i < moves.size(); i++) {
-            const Move& keyMove = moves[i];
+        int first = lookupFound ? 1 : 0;
+        for (int i = first + 1; i < moves.size(); i++) {
+            const Move keyMove = moves[i];
             float key = exchangeVal(board, keyMove);
             int j = i - 1;
 
-            while (j >= 0 && exchangeVal(board, moves[j]) > key) {
+            while (j >= first && exchangeVal(board, moves[j]) < key) {
                 moves[j + 1] = moves[j];
                 j = j - 1;
             }
@@ -405,7 +610,5 @@ namespace choco {
         }
     }
 
-    Search::~Search() {
-        delete[] TT;
-    }
+    Search::~Search() = default;
 }
@@ -2,26 +2,72 @@
 
 #include "macros.h"
 #include "board.h"
+#include "eval.h"
+#include "pawns.h"
 #include "types.h"
+#include "stats.h"
+#include "tt.h"
+#include "perf_counters.h"
 
 #include <atomic>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace choco {
-    void initTT(); // should be called before any engine stuff
-    
-    enum TTFlag : uint8_t { TT_EXACT, TT_ALPHA, TT_BETA };
+    struct SearchBounds {
+        int64_t moveTime;
+        int depth = 0; // stop after completing this depth; 0 for no limit
+        uint64_t nodes = 0; // stop once about this many nodes are searched; 0 for no limit
+    };
 
-    struct TTEntry {
-        uint64_t key = 0;
-        float eval = 0;
-        int depth = -1;
-        TTFlag flag = TT_EXACT;
-        Move bestMove;
+    // search constants tuned by self-play (johnner_spsa). Integers, so they can be UCI spin options
+    struct SearchParams {
+        // late move reductions start after lmrBase + ln(depth) * ln(moves) / lmrDivisor moves,
+        // both in hundredths
+        int lmrBase = 99;
+        int lmrDivisor = 314;
+        // quiescence stops once a capture leaves it this far below alpha, doubled for promotions
+        int deltaMargin = 900; // centipawns
+        // reverse futility pruning cuts when the static eval is this far above beta per ply of depth
+        int futilityMargin = 100; // centipawns
     };
 
-    struct SearchBounds {
-        int64_t moveTime;
+    struct Tunable {
+        const char* name; // UCI option name
+        int SearchParams::* value;
+        int min;
+        int max;
+        double step; // how far SPSA perturbs the value at the end of tuning
+    };
+
+    inline constexpr Tunable TUNABLES[] = {
+        { "LmrBase",        &SearchParams::lmrBase,        0,   300,  10 },
+        { "LmrDivisor",     &SearchParams::lmrDivisor,     100, 800,  20 },
+        { "DeltaMargin",    &SearchParams::deltaMargin,    100, 2000, 50 },
+        { "FutilityMargin", &SearchParams::futilityMargin, 20,  400,  10 },
+    };
+
+    // search settings that can be changed between searches, e.g. through UCI options
+    struct SearchOptions {
+        bool lateMoveReductions = true;
+        bool deltaPruning = true;
+        bool reverseFutility = true;
+        // info and bestmove lines; engines driven in-process read the results instead
+        bool uciOutput = true;
+        SearchParams params;
+    };
+
+    // a score as UCI reports it
+    struct UciScore {
+        bool mate = false;
+        int value = 0; // centipawns, or moves to mate; negative when the side to move gets mated
+    };
+
+    // ROOT and PV nodes are searched with an open window and keep the principal variation;
+    // NON_PV nodes, almost the whole tree, only prove a move fails high or low
+    enum class NodeType {
+        ROOT, PV, NON_PV
     };
 
     class Search {
@@ -32,6 +78,12 @@ namespace choco {
         void stop();
 
         Move getBestMove();
+        // score of the last completed iteration in pawns, side to move's point of view
+        float getEval() const;
+        UciScore getUciScore() const;
+        // principal variation and depth of the last completed iteration
+        std::vector<Move> getPv() const;
+        int getDepth() const;
 
         const Board& getBoard() const;
 
@@ -41,26 +93,81 @@ namespace choco {
         void setBoard(const Board& board);
         void clearTT();
 
+        // lazy SMP: threads - 1 helpers search the same position and share the TT
+        void setThreads(int threads);
+        void setHashSize(size_t megabytes);
+
+        SearchOptions options;
+
+        // nodes visited by every thread in the last search
+        uint64_t getNodes() const;
+
+#ifdef BOT_SEARCH_STATS
+        const SearchStats& getStats() const;
+#endif
+#ifdef BOT_PERF_COUNTERS
+        // hardware counters summed over every thread in the last search
+        const PerfSample& getPerfSample() const;
+#endif
+
         ~Search();
     private:
+        Search(const Board& board, std::shared_ptr<TranspositionTable> tt, int threadIndex);
+
+        void iterate();
+        // picks the move with the best distance to mate when every root move is in the tablebases
+        bool probeRoot();
+        inline void countNode();
+        void checkTime();
+
         Board board;
         Move bestMove;
+        float bestEval;
+        int bestDepth;
 
         int depthSoFar;
+        int maxDepth;
+        uint64_t nodeLimit;
         std::atomic<bool> searching;
 
-        static constexpr int TT_BITS  = 22;
-        static constexpr size_t TT_SIZE  = 1 << TT_BITS;
-        static constexpr uint64_t TT_MASK = TT_SIZE - 1;
-
-        TTEntry *TT;
-
-        inline TTEntry& tt_probe(uint64_t key);
-        inline void tt_store(uint64_t key, float eval, int depth, TTFlag flag, const Move& bestMove);
-        inline bool tt_lookup(uint64_t key, TTEntry& out, int requiredDepth);
+        int threadIndex; // 0 for the main thread, which reports and owns the clock
+        std::vector<std::unique_ptr<Search>> helpers;
+
+        std::atomic<uint64_t> nodes; // written by the owning thread only, read by the main thread for nps
+        int64_t deadline;
+        int64_t startMs;
+        int64_t lastReportMs;
+        uint64_t lastReportNodes;
+
+        // keys of every position in the game so far, followed by the current search path
+        static constexpr size_t MAX_HISTORY = 2048;
+        std::vector<uint64_t> keyHistory;
+        bool isRepetition(const Board& board) const;
+
+#ifdef BOT_SEARCH_STATS
+        SearchStats stats;
+#endif
+#ifdef BOT_PERF_COUNTERS
+        PerfSample perfSample;
+#endif
+
+        std::shared_ptr<TranspositionTable> tt;
+        PawnTable pawnTable;
+        EvalCache evalCache;
+
+        static constexpr int MAX_PLY = 128;
+        MoveList rootMoves; // legal moves at the root, best of the last iteration first
+
+        // triangular PV table: pvTable[ply] holds the PV from ply onwards, up to pvLength[ply]
+        Move pvTable[MAX_PLY][MAX_PLY];
+        int pvLength[MAX_PLY];
+        // copy of the root PV after the last completed iteration
+        Move bestPv[MAX_PLY];
+        int bestPvLength;
 
         inline float quiesce(Board& board, float alpha, float beta);
-        float negamax(Board& board, float alpha, float beta, int depth);
+        template<NodeType node>
+        float negamax(Board& board, float alpha, float beta, int depth, int ply);
 
         inline void orderMoves(Board& board, uint64_t boardHash, MoveList& moves);
     };
@@ -69,6 +176,8 @@ namespace choco {
     template<bool clearTT>
     void Search::setBoard(const Board& board) {
         this->board = board;
+        keyHistory.clear();
+        keyHistory.push_back(board.key);
         if constexpr (clearTT) {
             this->clearTT();
         }
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "match.h"
+#include "nnue.h"
+#include "search.h"
+#include "str_util.h"
+#include "thread_pool.h"
+
+namespace {
+    using namespace choco;
+    using namespace choco::match;
+
+    void printUsage() {
+        std::cerr << "usage: johnner_spsa [--iterations N] [--pairs N] [--concurrency N]\n"
+                  << "                    [--tc BASE+INC | --movetime MS | --depth N] [--random-plies N]\n"
+                  << "                    [--seed N] [--r-end R] [--OPTION VALUE]...\n"
+                  << "tunes ";
+        for (const Tunable& tunable : TUNABLES) std::cerr << tunable.name << " ";
+        std::cerr << "\n--OPTION VALUE sets any other UCI option for both sides" << std::endl;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    constexpr size_t TUNABLE_COUNT = std::size(TUNABLES);
+
+    // gain schedules from Spall, with the usual choices for the exponents. the perturbation
+    // shrinks to a tunable's step by the last iteration, and the learning rate to r-end
+    constexpr double ALPHA = 0.602;
+    constexpr double GAMMA = 0.101;
+
+    struct Arguments {
+        int iterations = 1000;
+        int pairs = 4; // game pairs per iteration
+        int concurrency = 1;
+        TimeControl timeControl;
+        Adjudication adjudication;
+        int randomPlies = 8;
+        uint64_t seed = 1;
+        double rEnd = 0.002;
+        std::vector<std::pair<std::string, std::string>> options;
+    };
+
+    template<typename T>
+    bool parseInto(std::string_view text, T& target) {
+        std::optional<T> value = util::parseNumber<T>(text);
+        if (value) target = *value;
+        return value.has_value();
+    }
+
+    bool parseArguments(int argc, char* argv[], Arguments& args) {
+        for (int i = 1; i < argc; i++) {
+            std::string_view flag = argv[i];
+            if (!flag.starts_with("--") || i + 1 >= argc) return false;
+            std::string_view value = argv[++i];
+
+            bool ok = true;
+            if (flag == "--iterations") {
+                ok = parseInto(value, args.iterations) && args.iterations > 0;
+            } else if (flag == "--pairs") {
+                ok = parseInto(value, args.pairs) && args.pairs > 0;
+            } else if (flag == "--concurrency") {
+                ok = parseInto(value, args.concurrency) && args.concurrency > 0;
+            } else if (flag == "--tc") {
+                size_t plus = value.find('+');
+                double base = 0;
+                double increment = 0;
+                ok = parseInto(value.substr(0, plus), base) && base > 0
+                     && (plus == std::string_view::npos || parseInto(value.substr(plus + 1), increment));
+                args.timeControl.baseMs = (int64_t) (base * 1000);
+                args.timeControl.incrementMs = (int64_t) (increment * 1000);
+            } else if (flag == "--movetime") {
+                ok = parseInto(value, args.timeControl.moveTimeMs) && args.timeControl.moveTimeMs > 0;
+            } else if (flag == "--depth") {
+                ok = parseInto(value, args.timeControl.depth) && args.timeControl.depth > 0;
+            } else if (flag == "--random-plies") {
+                ok = parseInto(value, args.randomPlies) && args.randomPlies >= 0;
+            } else if (flag == "--seed") {
+                ok = parseInto(value, args.seed);
+            } else if (flag == "--r-end") {
+                ok = parseInto(value, args.rEnd) && args.rEnd > 0;
+            } else {
+                args.options.emplace_back(flag.substr(2), value);
+            }
+
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    // both players of one concurrent game
+    struct Seat {
+        std::unique_ptr<EnginePlayer> players[2];
+    };
+
+    bool setParams(EnginePlayer& player, const std::vector<int>& values) {
+        for (size_t i = 0; i < TUNABLE_COUNT; i++) {
+            if (!player.setOption(TUNABLES[i].name, std::to_string(values[i]))) return false;
+        }
+        return true;
+    }
+
+    std::vector<int> rounded(const std::vector<double>& theta) {
+        std::vector<int> values(TUNABLE_COUNT);
+        for (size_t i = 0; i < TUNABLE_COUNT; i++) {
+            values[i] = std::clamp((int) std::lround(theta[i]), TUNABLES[i].min, TUNABLES[i].max);
+        }
+        return values;
+    }
+
+    void printValues(const std::vector<double>& theta) {
+        for (size_t i = 0; i < TUNABLE_COUNT; i++) {
+            std::printf("%s%s %.2f", i ? ", " : "", TUNABLES[i].name, theta[i]);
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+    // evaluates like johnner_uci, so the constants are tuned for the eval that will use them
+    if (!nnue::loadEmbedded()) {
+        nnue::loadFile("johnner.nnue");
+    }
+
+    std::vector<Seat> seats(args.concurrency);
+    for (Seat& seat : seats) {
+        for (int side = 0; side < 2; side++) {
+            seat.players[side] = std::make_unique<EnginePlayer>(side == 0 ? "plus" : "minus");
+            for (const auto& [option, value] : args.options) {
+                if (!seat.players[side]->setOption(option, value)) {
+                    std::cerr << "invalid option " << option << "=" << value << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    std::vector<double> theta(TUNABLE_COUNT);
+    for (size_t i = 0; i < TUNABLE_COUNT; i++) theta[i] = SearchParams().*TUNABLES[i].value;
+
+    // the stability constant A is a tenth of the run, as usual
+    const double stability = args.iterations * 0.1;
+    std::vector<double> c(TUNABLE_COUNT);
+    std::vector<double> a(TUNABLE_COUNT);
+    for (size_t i = 0; i < TUNABLE_COUNT; i++) {
+        c[i] = TUNABLES[i].step * std::pow(args.iterations, GAMMA);
+        a[i] = args.rEnd * TUNABLES[i].step * TUNABLES[i].step * std::pow(args.iterations + stability, ALPHA);
+    }
+
+    std::mt19937_64 rng(args.seed);
+    ThreadPool pool((size_t) args.concurrency);
+    std::mutex mutex;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int k = 1; k <= args.iterations; k++) {
+        std::vector<double> delta(TUNABLE_COUNT);
+        std::vector<double> ck(TUNABLE_COUNT);
+        std::vector<double> plus(TUNABLE_COUNT);
+        std::vector<double> minus(TUNABLE_COUNT);
+        for (size_t i = 0; i < TUNABLE_COUNT; i++) {
+            delta[i] = (rng() & 1) ? 1 : -1;
+            ck[i] = c[i] / std::pow(k, GAMMA);
+            plus[i] = theta[i] + ck[i] * delta[i];
+            minus[i] = theta[i] - ck[i] * delta[i];
+        }
+        const std::vector<int> plusValues = rounded(plus);
+        const std::vector<int> minusValues = rounded(minus);
+
+        for (Seat& seat : seats) {
+            setParams(*seat.players[0], plusValues);
+            setParams(*seat.players[1], minusValues);
+        }
+
+        std::vector<int> freeSeats;
+        for (int seat = 0; seat < args.concurrency; seat++) freeSeats.push_back(seat);
+
+        // wins minus losses of the plus side
+        int result = 0;
+        std::vector<std::future<void>> games;
+        for (int game = 0; game < 2 * args.pairs; game++) {
+            games.push_back(pool.submit([&, game]() {
+                uint64_t openingSeed = args.seed + ((uint64_t) k << 20) + game / 2;
+                std::string fen = randomOpening(args.randomPlies, openingSeed);
+
+                int seat;
+                {
+                    std::lock_guard lock(mutex);
+                    seat = freeSeats.back();
+                    freeSeats.pop_back();
+                }
+
+                // the second game of a pair swaps colors
+                int plusColor = game % 2;
+                Player& white = *seats[seat].players[plusColor];
+                Player& black = *seats[seat].players[1 - plusColor];
+                Game played = playGame(white, black, fen, args.timeControl, args.adjudication);
+
+                std::lock_guard lock(mutex);
+                freeSeats.push_back(seat);
+                if (played.result == Result::DRAW) return;
+                bool whiteWon = played.result == Result::WHITE_WIN;
+                result += whiteWon == (plusColor == 0) ? 1 : -1;
+            }));
+        }
+        for (auto& game : games) game.get();
+
+        for (size_t i = 0; i < TUNABLE_COUNT; i++) {
+            double ak = a[i] / std::pow(k + stability, ALPHA);
+            // a_k / c_k^2 * c_k: the step is measured in units of the perturbation
+            theta[i] += ak / ck[i] * result * delta[i];
+            theta[i] = std::clamp<double>(theta[i], TUNABLES[i].min, TUNABLES[i].max);
+        }
+
+        std::printf("iteration %d (%.0fs) result %+d: ", k, secondsSince(start), result);
+        printValues(theta);
+        std::fflush(stdout);
+    }
+
+    std::vector<int> values = rounded(theta);
+    for (size_t i = 0; i < TUNABLE_COUNT; i++) {
+        std::printf("setoption name %s value %d\n", TUNABLES[i].name, values[i]);
+    }
+    return 0;
+}
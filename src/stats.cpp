@@ -0,0 +1,104 @@
+#include "stats.h"
+
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+namespace choco {
+    namespace {
+        double ratio(uint64_t num, uint64_t den) {
+            return den == 0 ? 0.0 : (double) num / (double) den;
+        }
+
+        // highest depth slot with any recorded nodes, so output doesn't list 64 zeroes
+        int lastUsedDepth(const uint64_t (&arr)[SearchStats::MAX_DEPTH]) {
+            for (int i = SearchStats::MAX_DEPTH - 1; i >= 0; i--) {
+                if (arr[i]) return i;
+            }
+            return -1;
+        }
+    }
+
+    void SearchStats::clear() {
+        std::memset(this, 0, sizeof(SearchStats));
+    }
+
+    void SearchStats::endIteration() {
+        if (iterations >= MAX_DEPTH) return;
+
+        uint64_t before = 0;
+        for (int i = 0; i < iterations; i++) before += iterationNodes[i];
+
+        iterationNodes[iterations++] = mainNodes + qsNodes - before;
+    }
+
+    std::string SearchStats::toString() const {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(3);
+
+        oss << "info string stats"
+            << " nodes " << mainNodes
+            << " qnodes " << qsNodes
+            << " qratio " << ratio(qsNodes, mainNodes + qsNodes)
+            << " ttprobes " << ttProbes
+            << " tthits " << ttHits
+            << " ttcutoffs " << ttCutoffs
+            << " cutoffs " << betaCutoffs
+            << " firstcutoff " << ratio(firstMoveCutoffs, betaCutoffs)
+            << " lmr " << lmrReductions
+            << " lmrresearch " << lmrResearches
+            << " deltaprunes " << deltaPrunes
+            << " futilityprunes " << futilityPrunes;
+
+        oss << " ebf";
+        for (int i = 1; i < iterations; i++) {
+            oss << " " << ratio(iterationNodes[i], iterationNodes[i - 1]);
+        }
+
+        // branching factor from one remaining depth to the next
+        oss << " bf";
+        for (int d = lastUsedDepth(depthNodes); d > 1; d--) {
+            oss << " " << d << ":" << ratio(depthNodes[d - 1], depthNodes[d]);
+        }
+
+        return oss.str();
+    }
+
+    std::string SearchStats::toJson() const {
+        std::ostringstream oss;
+        oss << std::fixed << std::setprecision(4);
+
+        auto array = [&oss](const uint64_t* arr, int count) {
+            oss << "[";
+            for (int i = 0; i < count; i++) {
+                if (i) oss << ",";
+                oss << arr[i];
+            }
+            oss << "]";
+        };
+
+        int depths = lastUsedDepth(depthNodes) + 1;
+
+        oss << "{\"nodes\":" << mainNodes
+            << ",\"qnodes\":" << qsNodes
+            << ",\"tt\":{\"probes\":" << ttProbes << ",\"hits\":" << ttHits << ",\"cutoffs\":" << ttCutoffs << "}"
+            << ",\"cutoffs\":" << betaCutoffs
+            << ",\"firstMoveCutoffs\":" << firstMoveCutoffs
+            << ",\"firstMoveCutoffRate\":" << ratio(firstMoveCutoffs, betaCutoffs)
+            << ",\"lmr\":{\"reductions\":" << lmrReductions << ",\"researches\":" << lmrResearches << "}"
+            << ",\"deltaPrunes\":" << deltaPrunes
+            << ",\"futilityPrunes\":" << futilityPrunes;
+
+        oss << ",\"iterationNodes\":";
+        array(iterationNodes, iterations);
+        oss << ",\"depthNodes\":";
+        array(depthNodes, depths);
+        oss << ",\"depthCutoffs\":";
+        array(depthCutoffs, depths);
+        oss << ",\"depthReductions\":";
+        array(depthReductions, depths);
+        oss << "}";
+
+        return oss.str();
+    }
+} // namespace choco
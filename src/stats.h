@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Search statistics are compiled out unless BOT_SEARCH_STATS is defined
+// (cmake -DJOHNNER_SEARCH_STATS=ON). When disabled, the macros expand to nothing
+// and Search does not carry a SearchStats block at all.
+#ifdef BOT_SEARCH_STATS
+#define STATS_INC(STATS, FIELD) ((STATS).FIELD++)
+#define STATS_INC_AT(STATS, FIELD, DEPTH) ((STATS).FIELD[SearchStats::depthSlot(DEPTH)]++)
+#else
+#define STATS_INC(STATS, FIELD) ((void) 0)
+#define STATS_INC_AT(STATS, FIELD, DEPTH) ((void) 0)
+#endif
+
+namespace choco {
+    struct SearchStats {
+        static constexpr int MAX_DEPTH = 64;
+
+        uint64_t mainNodes;
+        uint64_t qsNodes;
+
+        uint64_t ttProbes;
+        uint64_t ttHits;
+        uint64_t ttCutoffs;
+
+        uint64_t betaCutoffs;
+        uint64_t firstMoveCutoffs;
+
+        uint64_t lmrReductions;
+        uint64_t lmrResearches;
+        uint64_t deltaPrunes;
+        uint64_t futilityPrunes;
+
+        // indexed by remaining depth (negamax's depth parameter)
+        uint64_t depthNodes[MAX_DEPTH];
+        uint64_t depthCutoffs[MAX_DEPTH];
+        uint64_t depthReductions[MAX_DEPTH];
+
+        // total main + qs nodes at the end of each iterative deepening iteration
+        uint64_t iterationNodes[MAX_DEPTH];
+        int iterations;
+
+        void clear();
+        void endIteration();
+
+        std::string toString() const;
+        std::string toJson() const;
+
+        static constexpr int depthSlot(int depth) {
+            return depth < 0 ? 0 : (depth >= MAX_DEPTH ? MAX_DEPTH - 1 : depth);
+        }
+    };
+} // namespace choco
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace choco::util {
@@ -21,6 +26,41 @@ namespace choco::util {
         return res;
     }
 
+    inline std::string_view trim(std::string_view s) {
+        constexpr std::string_view whitespace = " \t\r\n";
+        size_t start = s.find_first_not_of(whitespace);
+        if (start == std::string_view::npos) return {};
+        return s.substr(start, s.find_last_not_of(whitespace) - start + 1);
+    }
+
+    // pops the next space-separated token off the front of s. returns an empty view when s runs out
+    inline std::string_view nextToken(std::string_view& s) {
+        size_t start = s.find_first_not_of(' ');
+        if (start == std::string_view::npos) {
+            s = {};
+            return {};
+        }
+
+        size_t end = s.find(' ', start);
+        std::string_view token = s.substr(start, end - start);
+        s = (end == std::string_view::npos) ? std::string_view() : s.substr(end);
+        return token;
+    }
+
+    inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+            return std::tolower((unsigned char) x) == std::tolower((unsigned char) y);
+        });
+    }
+
+    template <typename T>
+    std::optional<T> parseNumber(std::string_view s) {
+        T value;
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+        if (ec != std::errc() || ptr != s.data() + s.size()) return std::nullopt;
+        return value;
+    }
+
     inline int findRange(const std::string& string, const std::string& start,
                                        const std::string& end) {
         const auto startPos = string.find(start);
@@ -0,0 +1,448 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+
+#include "bithelpers.h"
+#include "macros.h"
+
+namespace choco::tb {
+    namespace {
+        constexpr uint32_t FILE_MAGIC = 0x3142544A; // "JTB1"
+        constexpr uint32_t FILE_VERSION = 1;
+        constexpr size_t HEADER_SIZE = 24;
+        constexpr uint32_t BLOCK_SIZE = 1024;
+
+        // order of the pieces in names and indices
+        constexpr uint8_t NAME_ORDER[5] = { QUEEN, ROOK, BISHOP, KNIGHT, PAWN };
+        constexpr char PIECE_LETTERS[6] = { 'K', 'Q', 'B', 'N', 'R', 'P' };
+        constexpr int PIECE_STRENGTH[6] = { 0, 9, 3, 3, 5, 1 };
+
+        constexpr int PAWNLESS_KING_SLOTS = 10;
+        constexpr int PAWN_KING_SLOTS = 32;
+
+        struct KingSlots {
+            int8_t slot[64];
+            uint8_t square[PAWN_KING_SLOTS];
+        };
+
+        // pawnless tables: the a1-d1-d4 triangle
+        constexpr KingSlots makePawnlessSlots() {
+            KingSlots slots{};
+            int n = 0;
+            for (uint8_t square = 0; square < 64; square++) {
+                slots.slot[square] = -1;
+                if (getFile(square) <= 3 && getRank(square) <= getFile(square)) {
+                    slots.square[n] = square;
+                    slots.slot[square] = (int8_t) n++;
+                }
+            }
+            return slots;
+        }
+
+        // pawn tables: files a-d
+        constexpr KingSlots makePawnSlots() {
+            KingSlots slots{};
+            int n = 0;
+            for (uint8_t square = 0; square < 64; square++) {
+                slots.slot[square] = -1;
+                if (getFile(square) <= 3) {
+                    slots.square[n] = square;
+                    slots.slot[square] = (int8_t) n++;
+                }
+            }
+            return slots;
+        }
+
+        constexpr KingSlots PAWNLESS_SLOTS = makePawnlessSlots();
+        constexpr KingSlots PAWN_SLOTS = makePawnSlots();
+
+        // symmetry bits: 1 mirrors files, 2 mirrors ranks, 4 mirrors along the a1-h8 diagonal
+        constexpr uint8_t transform(uint8_t square, uint8_t symmetry) {
+            if (symmetry & 1) square ^= 7;
+            if (symmetry & 2) square ^= 56;
+            if (symmetry & 4) square = (uint8_t) ((square >> 3) | ((square & 7) << 3));
+            return square;
+        }
+
+        uint8_t symmetryFor(uint8_t whiteKing, bool pawns) {
+            uint8_t symmetry = 0;
+            if (getFile(whiteKing) > 3) symmetry |= 1;
+            if (pawns) return symmetry;
+
+            if (getRank(whiteKing) > 3) symmetry |= 2;
+            uint8_t square = transform(whiteKing, symmetry);
+            if (getRank(square) > getFile(square)) symmetry |= 4;
+            return symmetry;
+        }
+
+        uint32_t readLe32(const uint8_t* bytes) {
+            return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+        }
+        uint64_t readLe64(const uint8_t* bytes) {
+            return readLe32(bytes) | ((uint64_t) readLe32(bytes + 4) << 32);
+        }
+
+        void writeLe(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+            for (int i = 0; i < bytes; i++) out.push_back((uint8_t) (value >> (8 * i)));
+        }
+
+        struct LoadedTable {
+            Indexer indexer;
+            TableFile wdl;
+            TableFile dtm;
+        };
+
+        // keyed by the material key of the table's own (canonical) material
+        std::unordered_map<uint32_t, std::unique_ptr<LoadedTable>> tables;
+        int largestTable = 0;
+
+        // tables don't know about en passant, but a double push only sets the square; it matters when
+        // a pawn can actually take
+        bool canCaptureEnPassant(const Board& board) {
+            uint8_t target = board.state.enpassantSquare;
+            if (target == INVALID_SQUARE) return false;
+
+            uint8_t stm = board.state.activeColor;
+            uint64_t pushed = getMask(stm == SIDE_WHITE ? target - 8 : target + 8);
+            uint64_t capturers = ((pushed & ~BITBOARD_FILE_A) >> 1) | ((pushed & ~BITBOARD_FILE_H) << 1);
+            return capturers & board.bitboards[stm][PAWN];
+        }
+
+        std::optional<int8_t> probe(const Board& board, bool distance) {
+            if (board.state.castling != 0 || canCaptureEnPassant(board)) return std::nullopt;
+
+            Material material = Material::of(board);
+            if (material.counts[SIDE_WHITE][KING] != 1 || material.counts[SIDE_BLACK][KING] != 1) return std::nullopt;
+            if (material.pieceCount() == 2) return DRAW;
+
+            bool flip = false;
+            auto it = tables.find(material.key());
+            if (it == tables.end()) {
+                it = tables.find(material.flipped().key());
+                flip = true;
+            }
+            if (it == tables.end()) return std::nullopt;
+
+            const TableFile& file = distance ? it->second->dtm : it->second->wdl;
+            if (!file.isOpen()) return std::nullopt;
+
+            return file.probe(it->second->indexer.index(board, flip));
+        }
+    }
+
+    Material Material::of(const Board& board) {
+        Material material;
+        for (uint8_t side = 0; side < 2; side++) {
+            for (uint8_t piece = 0; piece < 6; piece++) {
+                material.counts[side][piece] = countOnes(board.bitboards[side][piece]);
+            }
+        }
+        return material;
+    }
+
+    std::optional<Material> Material::parse(std::string_view name) {
+        Material material;
+        uint8_t side = SIDE_WHITE;
+
+        for (char c : name) {
+            if (c == 'v' && side == SIDE_WHITE) {
+                side = SIDE_BLACK;
+                continue;
+            }
+
+            const char* letter = std::find(PIECE_LETTERS, PIECE_LETTERS + 6, c);
+            if (letter == PIECE_LETTERS + 6) return std::nullopt;
+            material.counts[side][letter - PIECE_LETTERS]++;
+        }
+
+        if (side != SIDE_BLACK || material.counts[SIDE_WHITE][KING] != 1 || material.counts[SIDE_BLACK][KING] != 1) {
+            return std::nullopt;
+        }
+        if (material.pieceCount() > MAX_PIECES) return std::nullopt;
+        return material;
+    }
+
+    std::string Material::name() const {
+        std::string name;
+        for (uint8_t side = 0; side < 2; side++) {
+            if (side == SIDE_BLACK) name += 'v';
+            name += 'K';
+            for (uint8_t piece : NAME_ORDER) name.append(counts[side][piece], PIECE_LETTERS[piece]);
+        }
+        return name;
+    }
+
+    uint32_t Material::key() const {
+        uint32_t key = 0;
+        for (uint8_t side = 0; side < 2; side++) {
+            for (uint8_t piece : NAME_ORDER) key = (key << 3) | counts[side][piece];
+        }
+        return key;
+    }
+
+    int Material::pieceCount() const {
+        int count = 0;
+        for (uint8_t side = 0; side < 2; side++) {
+            for (uint8_t piece = 0; piece < 6; piece++) count += counts[side][piece];
+        }
+        return count;
+    }
+
+    bool Material::hasPawns() const {
+        return counts[SIDE_WHITE][PAWN] || counts[SIDE_BLACK][PAWN];
+    }
+
+    Material Material::flipped() const {
+        Material material;
+        std::memcpy(material.counts[SIDE_WHITE], counts[SIDE_BLACK], sizeof(counts[0]));
+        std::memcpy(material.counts[SIDE_BLACK], counts[SIDE_WHITE], sizeof(counts[0]));
+        return material;
+    }
+
+    bool Material::isCanonical() const {
+        int strength[2] = {};
+        for (uint8_t side = 0; side < 2; side++) {
+            for (uint8_t piece = 0; piece < 6; piece++) strength[side] += counts[side][piece] * PIECE_STRENGTH[piece];
+        }
+
+        if (strength[SIDE_WHITE] != strength[SIDE_BLACK]) return strength[SIDE_WHITE] > strength[SIDE_BLACK];
+        // equal strength (KBvKN, KRvKR): the key is just a tie-break that one side of the pair wins
+        return key() >= flipped().key();
+    }
+
+    Material Material::canonical() const {
+        return isCanonical() ? *this : flipped();
+    }
+
+    Indexer::Indexer(const Material& material) : pawns(material.hasPawns()) {
+        slots.push_back({ SIDE_BLACK, KING });
+        for (uint8_t side = 0; side < 2; side++) {
+            for (uint8_t piece : NAME_ORDER) {
+                for (int i = 0; i < material.counts[side][piece]; i++) slots.push_back({ side, piece });
+            }
+        }
+
+        entries = (pawns ? PAWN_KING_SLOTS : PAWNLESS_KING_SLOTS) * 2;
+        for (size_t i = 0; i < slots.size(); i++) entries *= 64;
+    }
+
+    uint64_t Indexer::index(const Board& board, bool flip) const {
+        uint8_t whiteKing = countTrailingZeros(board.bitboards[SIDE_WHITE ^ flip][KING]) ^ (flip ? 56 : 0);
+        return index(board, flip, symmetryFor(whiteKing, pawns));
+    }
+
+    int Indexer::indices(const Board& board, uint64_t out[2]) const {
+        uint8_t whiteKing = countTrailingZeros(board.bitboards[SIDE_WHITE][KING]);
+        uint8_t symmetry = symmetryFor(whiteKing, pawns);
+        out[0] = index(board, false, symmetry);
+
+        // the diagonal mirror is applied last, so it keeps a king on the diagonal where it is
+        uint8_t square = transform(whiteKing, symmetry);
+        if (pawns || getRank(square) != getFile(square)) return 1;
+        out[1] = index(board, false, symmetry ^ 4);
+        return out[1] == out[0] ? 1 : 2;
+    }
+
+    uint64_t Indexer::index(const Board& board, bool flip, uint8_t symmetry) const {
+        // flipping swaps the colors and mirrors the ranks, so the table's white may be black on the board
+        const uint8_t flipSquare = flip ? 56 : 0;
+        const uint8_t flipSide = flip ? 1 : 0;
+
+        uint8_t whiteKing = countTrailingZeros(board.bitboards[SIDE_WHITE ^ flipSide][KING]) ^ flipSquare;
+
+        const KingSlots& kingSlots = pawns ? PAWN_SLOTS : PAWNLESS_SLOTS;
+        uint64_t index = kingSlots.slot[transform(whiteKing, symmetry)];
+
+        // identical pieces are a group of consecutive slots, indexed in ascending order
+        for (size_t i = 0; i < slots.size();) {
+            uint8_t squares[64];
+            int n = 0;
+            iterateIndices(board.bitboards[slots[i].side ^ flipSide][slots[i].piece], [&](uint8_t square) {
+                squares[n++] = transform(square ^ flipSquare, symmetry);
+            });
+            std::sort(squares, squares + n);
+
+            for (int j = 0; j < n; j++) index = index * 64 + squares[j];
+            i += n;
+        }
+
+        // the side to move is the top of the index, so each half is mostly wins or mostly losses
+        return index + (board.state.activeColor ^ flipSide) * (entries / 2);
+    }
+
+    bool Indexer::decode(uint64_t index, Board& board) const {
+        std::memset(board.bitboards, 0, sizeof(board.bitboards));
+        board.occupiedSquares[SIDE_WHITE] = 0;
+        board.occupiedSquares[SIDE_BLACK] = 0;
+        uint8_t stm = index >= entries / 2;
+        board.state = { stm, 0, 0, INVALID_SQUARE, 0 };
+        index -= stm * (entries / 2);
+
+        uint8_t squares[MAX_PIECES];
+        for (size_t i = slots.size(); i-- > 0;) {
+            squares[i] = index & 63;
+            index >>= 6;
+        }
+
+        const KingSlots& kingSlots = pawns ? PAWN_SLOTS : PAWNLESS_SLOTS;
+        board.bitboards[SIDE_WHITE][KING] = getMask(kingSlots.square[index]);
+        board.occupiedSquares[SIDE_WHITE] = board.bitboards[SIDE_WHITE][KING];
+
+        for (size_t i = 0; i < slots.size(); i++) {
+            uint64_t mask = getMask(squares[i]);
+            if ((board.occupiedSquares[SIDE_WHITE] | board.occupiedSquares[SIDE_BLACK]) & mask) return false;
+            if (slots[i].piece == PAWN && (mask & (BITBOARD_RANK_1 | BITBOARD_RANK_8))) return false;
+            // only the ascending order of identical pieces is ever indexed
+            if (i > 0 && slots[i].side == slots[i - 1].side && slots[i].piece == slots[i - 1].piece
+                && squares[i] < squares[i - 1]) return false;
+
+            board.bitboards[slots[i].side][slots[i].piece] |= mask;
+            board.occupiedSquares[slots[i].side] |= mask;
+        }
+
+        // the side that just moved can't be in check
+        return !(board.getAttacks(stm) & board.bitboards[oppositeSide(stm)][KING]);
+    }
+
+    bool TableFile::open(const std::string& path) {
+        close();
+        if (!file.open(path)) return false;
+
+        const uint8_t* data = file.data();
+        if (file.size() < HEADER_SIZE || readLe32(data) != FILE_MAGIC || readLe32(data + 4) != FILE_VERSION) {
+            close();
+            return false;
+        }
+
+        entries = readLe64(data + 8);
+        blockSize = readLe32(data + 16);
+        uint32_t blockCount = readLe32(data + 20);
+
+        offsets = data + HEADER_SIZE;
+        blocks = offsets + 4 * ((size_t) blockCount + 1);
+        if (blockSize == 0 || (entries + blockSize - 1) / blockSize != blockCount
+            || (size_t) (blocks - data) > file.size()
+            || readLe32(offsets + 4 * (size_t) blockCount) > file.size() - (blocks - data)) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void TableFile::close() {
+        file.close();
+        entries = 0;
+        blockSize = 0;
+        offsets = nullptr;
+        blocks = nullptr;
+    }
+
+    int8_t TableFile::probe(uint64_t index) const {
+        uint64_t block = index / blockSize;
+        uint32_t position = (uint32_t) (index % blockSize);
+
+        // runs of (length - 1, value) pairs
+        const uint8_t* run = blocks + readLe32(offsets + 4 * block);
+        while (position > run[0]) {
+            position -= run[0] + 1;
+            run += 2;
+        }
+        return (int8_t) run[1];
+    }
+
+    std::vector<int8_t> TableFile::decompress() const {
+        std::vector<int8_t> values;
+        values.reserve(entries);
+
+        const uint8_t* run = blocks;
+        const uint8_t* end = blocks + readLe32(offsets + 4 * ((entries + blockSize - 1) / blockSize));
+        for (; run < end; run += 2) values.insert(values.end(), run[0] + 1, (int8_t) run[1]);
+
+        return values;
+    }
+
+    bool writeTable(const std::string& path, const std::vector<int8_t>& values) {
+        uint64_t blockCount = (values.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        std::vector<uint8_t> header;
+        writeLe(header, FILE_MAGIC, 4);
+        writeLe(header, FILE_VERSION, 4);
+        writeLe(header, values.size(), 8);
+        writeLe(header, BLOCK_SIZE, 4);
+        writeLe(header, blockCount, 4);
+
+        std::vector<uint8_t> data;
+        int8_t previous = DRAW;
+        for (uint64_t block = 0; block < blockCount; block++) {
+            writeLe(header, data.size(), 4);
+
+            uint64_t end = std::min<uint64_t>(values.size(), (block + 1) * BLOCK_SIZE);
+            for (uint64_t i = block * BLOCK_SIZE; i < end;) {
+                // invalid positions extend whatever run they are in
+                int8_t value = values[i] == INVALID ? previous : values[i];
+                uint64_t length = 1;
+                while (i + length < end && length < 256 && (values[i + length] == value || values[i + length] == INVALID)) {
+                    length++;
+                }
+
+                data.push_back((uint8_t) (length - 1));
+                data.push_back((uint8_t) value);
+                previous = value;
+                i += length;
+            }
+        }
+        writeLe(header, data.size(), 4);
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(header.data()), (std::streamsize) header.size());
+        out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize) data.size());
+        return (bool) out;
+    }
+
+    int load(const std::string& directory) {
+        unload();
+
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            if (entry.path().extension() != ".wdl") continue;
+
+            std::optional<Material> material = Material::parse(entry.path().stem().string());
+            if (!material || !material->isCanonical()) continue;
+
+            auto table = std::make_unique<LoadedTable>(LoadedTable{ Indexer(*material), {}, {} });
+            if (!table->wdl.open(entry.path().string()) || table->wdl.size() != table->indexer.size()) continue;
+
+            std::filesystem::path dtmPath = entry.path();
+            dtmPath.replace_extension(".dtm");
+            if (table->dtm.open(dtmPath.string()) && table->dtm.size() != table->indexer.size()) table->dtm.close();
+
+            largestTable = std::max(largestTable, material->pieceCount());
+            tables[material->key()] = std::move(table);
+        }
+
+        return (int) tables.size();
+    }
+
+    void unload() {
+        tables.clear();
+        largestTable = 0;
+    }
+
+    int maxPieces() {
+        return largestTable;
+    }
+
+    std::optional<int8_t> probeWdl(const Board& board) {
+        return probe(board, false);
+    }
+
+    std::optional<int8_t> probeDtm(const Board& board) {
+        return probe(board, true);
+    }
+} // namespace choco::tb
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "board.h"
+#include "mapped_file.h"
+
+// Endgame tablebases generated by johnner_tbgen (see TABLEBASES.md for the index and file format).
+// Each material configuration has a .wdl file (win/draw/loss) probed inside the search and a .dtm
+// file (distance to mate) probed at the root. Both are memory mapped, so loading a directory is instant.
+namespace choco::tb {
+    static constexpr int MAX_PIECES = 5;
+
+    // values are from the side to move's point of view: positive wins, negative loses, 0 draws.
+    // in .dtm files the magnitude is the distance to mate in moves, .wdl files only hold -1, 0 and 1
+    constexpr int8_t winIn(int moves) {
+        return (int8_t) moves;
+    }
+    constexpr int8_t lossIn(int moves) {
+        return (int8_t) (-moves - 1);
+    }
+    constexpr int pliesToMate(int8_t value) {
+        return value > 0 ? 2 * value - 1 : 2 * (-value - 1);
+    }
+
+    static constexpr int8_t DRAW = 0;
+    static constexpr int MAX_DTM = 126; // moves
+    // position that can't occur (overlapping pieces, side not to move in check). never stored in files
+    static constexpr int8_t INVALID = 127;
+
+    // pieces of both sides. the first side is white in the table, whatever its color on the board
+    struct Material {
+        uint8_t counts[2][6] = {};
+
+        static Material of(const Board& board);
+        // "KQvKR"; nothing if the name is malformed
+        static std::optional<Material> parse(std::string_view name);
+
+        std::string name() const;
+        uint32_t key() const;
+        int pieceCount() const;
+        bool hasPawns() const;
+
+        Material flipped() const;
+        // tables are only built for the stronger side as white
+        bool isCanonical() const;
+        Material canonical() const;
+    };
+
+    // maps positions of one material configuration to table indices. pawnless tables move the white
+    // king into the a1-d1-d4 triangle with any of the board's 8 symmetries, pawn tables mirror it onto
+    // files a-d. identical pieces are stored in ascending square order
+    class Indexer {
+    public:
+        explicit Indexer(const Material& material);
+
+        uint64_t size() const {
+            return entries;
+        }
+
+        // board must have the indexer's material, with the colors swapped when flip is set
+        uint64_t index(const Board& board, bool flip = false) const;
+        // index() and, for a pawnless position whose white king lands on the a1-h8 diagonal, the index
+        // of its mirror image along that diagonal, which holds the same position. returns how many
+        int indices(const Board& board, uint64_t out[2]) const;
+        // sets up board with the position at index; false if the index holds no legal position
+        bool decode(uint64_t index, Board& board) const;
+    private:
+        uint64_t index(const Board& board, bool flip, uint8_t symmetry) const;
+
+        // every piece but the white king, in index order
+        struct Slot {
+            uint8_t side;
+            uint8_t piece;
+        };
+
+        bool pawns;
+        std::vector<Slot> slots;
+        uint64_t entries;
+    };
+
+    // block compressed array of values; random access decodes at most one block
+    class TableFile {
+    public:
+        bool open(const std::string& path);
+        void close();
+
+        bool isOpen() const {
+            return file.isOpen();
+        }
+        uint64_t size() const {
+            return entries;
+        }
+
+        int8_t probe(uint64_t index) const;
+        std::vector<int8_t> decompress() const;
+    private:
+        MappedFile file;
+        uint64_t entries = 0;
+        uint32_t blockSize = 0;
+        const uint8_t* offsets = nullptr;
+        const uint8_t* blocks = nullptr;
+    };
+
+    // INVALID values are don't-cares and get whatever compresses best
+    bool writeTable(const std::string& path, const std::vector<int8_t>& values);
+
+    // opens every .wdl/.dtm pair in directory and returns the number of tables; replaces earlier tables
+    int load(const std::string& directory);
+    void unload();
+
+    // largest piece count with a table loaded, 0 without tables
+    int maxPieces();
+
+    // nothing when the material has no table, or the position has castling rights or an en passant capture
+    std::optional<int8_t> probeWdl(const Board& board);
+    std::optional<int8_t> probeDtm(const Board& board);
+} // namespace choco::tb
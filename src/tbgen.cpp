@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bithelpers.h"
+#include "board.h"
+#include "str_util.h"
+#include "tablebase.h"
+#include "thread_pool.h"
+
+namespace {
+    using choco::tb::Material;
+
+    // only exists while a table is being solved
+    constexpr int8_t UNKNOWN = -128;
+    constexpr uint64_t CHUNK_SIZE = 1 << 16;
+
+    // lists of positions hold 32-bit indices
+    static_assert(choco::tb::MAX_PIECES <= 5);
+
+    void printUsage() {
+        std::cerr << "usage: johnner_tbgen <material>... [--out DIR] [--threads N]\n"
+                  << "       johnner_tbgen --all <pieces> [--out DIR] [--threads N]\n"
+                  << "materials are named like KQvKR, the stronger side first" << std::endl;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // every material the table's positions can reach with a capture or a promotion
+    std::vector<Material> successors(const Material& material) {
+        static constexpr uint8_t NON_KINGS[5] = { QUEEN, ROOK, BISHOP, KNIGHT, PAWN };
+        static constexpr uint8_t PROMOTIONS[4] = { QUEEN, ROOK, BISHOP, KNIGHT };
+
+        std::vector<Material> result;
+        for (uint8_t side = 0; side < 2; side++) {
+            for (uint8_t piece : NON_KINGS) {
+                if (!material.counts[side][piece]) continue;
+                Material captured = material;
+                captured.counts[side][piece]--;
+                result.push_back(captured);
+            }
+
+            if (!material.counts[side][PAWN]) continue;
+            for (uint8_t promotion : PROMOTIONS) {
+                Material promoted = material;
+                promoted.counts[side][PAWN]--;
+                promoted.counts[side][promotion]++;
+                result.push_back(promoted);
+
+                for (uint8_t piece : NON_KINGS) {
+                    if (!promoted.counts[oppositeSide(side)][piece]) continue;
+                    Material captured = promoted;
+                    captured.counts[oppositeSide(side)][piece]--;
+                    result.push_back(captured);
+                }
+            }
+        }
+        return result;
+    }
+
+    // every canonical material with kings and up to pieces - 2 other pieces, smallest first
+    std::vector<Material> allMaterials(int pieces) {
+        static constexpr uint8_t NON_KINGS[5] = { QUEEN, ROOK, BISHOP, KNIGHT, PAWN };
+
+        std::vector<Material> result;
+        auto add = [&](auto&& self, Material material, int slot, int remaining) -> void {
+            if (slot == 10) {
+                if (material.pieceCount() > 2 && material.isCanonical()) result.push_back(material);
+                return;
+            }
+            for (int n = 0; n <= remaining; n++) {
+                material.counts[slot / 5][NON_KINGS[slot % 5]] = (uint8_t) n;
+                self(self, material, slot + 1, remaining - n);
+            }
+        };
+
+        Material kings;
+        kings.counts[SIDE_WHITE][KING] = 1;
+        kings.counts[SIDE_BLACK][KING] = 1;
+        add(add, kings, 0, pieces - 2);
+
+        std::stable_sort(result.begin(), result.end(), [](const Material& a, const Material& b) {
+            return a.pieceCount() < b.pieceCount();
+        });
+        return result;
+    }
+
+    // calls visit with the index of every position that reaches board with a move inside the table,
+    // i.e. anything but a capture or a promotion. board is changed while it runs and restored after
+    template<typename F>
+    void forEachParent(const choco::tb::Indexer& indexer, choco::Board& board, F&& visit) {
+        using namespace choco;
+
+        uint8_t mover = oppositeSide(board.state.activeColor);
+        uint64_t empty = ~(board.occupiedSquares[SIDE_WHITE] | board.occupiedSquares[SIDE_BLACK]);
+        board.state.activeColor = mover;
+
+        for (uint8_t piece = 0; piece < 6; piece++) {
+            iterateIndices(board.bitboards[mover][piece], [&](uint8_t to) {
+                uint64_t froms;
+                if (piece == PAWN) {
+                    // one square back, or two back to the second rank
+                    int back = mover == SIDE_WHITE ? -8 : 8;
+                    int rank = mover == SIDE_WHITE ? getRank(to) : 7 - getRank(to);
+                    froms = 0;
+                    if (rank >= 2 && (empty & getMask(to + back))) {
+                        froms = getMask(to + back);
+                        if (rank == 3 && (empty & getMask(to + 2 * back))) froms |= getMask(to + 2 * back);
+                    }
+                } else {
+                    froms = board.plMoveBB(piece, to, mover) & empty;
+                }
+
+                iterateIndices(froms, [&](uint8_t from) {
+                    uint64_t moved = getMask(from) | getMask(to);
+                    board.bitboards[mover][piece] ^= moved;
+                    board.occupiedSquares[mover] ^= moved;
+
+                    uint64_t indices[2];
+                    int count = indexer.indices(board, indices);
+
+                    board.bitboards[mover][piece] ^= moved;
+                    board.occupiedSquares[mover] ^= moved;
+                    for (int i = 0; i < count; i++) visit(indices[i]);
+                });
+            });
+        }
+
+        board.state.activeColor = oppositeSide(mover);
+    }
+
+    class Generator {
+    public:
+        Generator(std::string directory, size_t threads) : directory(std::move(directory)), pool(threads) { }
+
+        // solves the table, and first every table it depends on, unless they were already written
+        void require(const Material& material);
+    private:
+        struct Solved {
+            choco::tb::Indexer indexer;
+            std::vector<int8_t> values;
+        };
+
+        void solve(const Material& material);
+        int8_t childValue(const choco::Board& child, const Material& own, Solved& table) const;
+        // whether every move from board reaches a position won in fewer than ply plies
+        bool isLost(choco::Board& board, int ply, const Material& own, Solved& table) const;
+
+        // runs func(begin, end, found) over [0, size) in chunks on the pool and returns everything
+        // the chunks appended to found
+        template<typename F>
+        std::vector<uint32_t> forEachChunk(uint64_t size, F&& func);
+
+        std::string path(const Material& material, const char* extension) const {
+            return (std::filesystem::path(directory) / (material.name() + extension)).string();
+        }
+
+        std::string directory;
+        choco::ThreadPool pool;
+        // node based, so references stay valid while more tables are added
+        std::unordered_map<uint32_t, Solved> solved;
+    };
+
+    void Generator::require(const Material& material) {
+        if (material.pieceCount() == 2 || solved.contains(material.key())) return;
+
+        choco::tb::TableFile file;
+        if (file.open(path(material, ".dtm"))) {
+            solved.emplace(material.key(), Solved{ choco::tb::Indexer(material), file.decompress() });
+            std::cout << material.name() << ": loaded from " << path(material, ".dtm") << std::endl;
+            return;
+        }
+
+        for (const Material& next : successors(material)) require(next.canonical());
+        solve(material);
+    }
+
+    int8_t Generator::childValue(const choco::Board& child, const Material& own, Solved& table) const {
+        Material material = Material::of(child);
+        if (material.key() == own.key()) {
+            return std::atomic_ref<int8_t>(table.values[table.indexer.index(child)]).load(std::memory_order_relaxed);
+        }
+        if (material.pieceCount() == 2) return choco::tb::DRAW;
+
+        const Solved& other = solved.at(material.canonical().key());
+        return other.values[other.indexer.index(child, !material.isCanonical())];
+    }
+
+    bool Generator::isLost(choco::Board& board, int ply, const Material& own, Solved& table) const {
+        for (const choco::Move& move : board.generateLegalMoves()) {
+            choco::UnmakeMove unmake = board.makeMove(move);
+            int8_t value = childValue(board, own, table);
+            board.unmakeMove(unmake);
+
+            if (value == UNKNOWN || value <= choco::tb::DRAW || choco::tb::pliesToMate(value) >= ply) return false;
+        }
+        return true;
+    }
+
+    template<typename F>
+    std::vector<uint32_t> Generator::forEachChunk(uint64_t size, F&& func) {
+        std::vector<std::future<std::vector<uint32_t>>> results;
+        for (uint64_t start = 0; start < size; start += CHUNK_SIZE) {
+            uint64_t end = std::min(size, start + CHUNK_SIZE);
+            results.push_back(pool.submit([&func, start, end]() {
+                std::vector<uint32_t> found;
+                func(start, end, found);
+                return found;
+            }));
+        }
+
+        std::vector<uint32_t> found;
+        for (auto& result : results) {
+            std::vector<uint32_t> part = result.get();
+            found.insert(found.end(), part.begin(), part.end());
+        }
+        return found;
+    }
+
+    void Generator::solve(const Material& material) {
+        using namespace choco;
+
+        auto start = std::chrono::steady_clock::now();
+
+        Solved& table = solved.emplace(material.key(), Solved{ tb::Indexer(material), {} }).first->second;
+        table.values.assign(table.indexer.size(), UNKNOWN);
+
+        // a move into another table (a capture or a promotion) decides a position at a fixed ply: it wins
+        // one ply after a lost child, and a position whose every move loses is lost one ply after its
+        // longest such win. 0 if those moves decide nothing, e.g. because one of them draws
+        std::vector<uint8_t> externalPly(table.values.size(), 0);
+
+        // mates, stalemates, impossible positions and moves into other tables
+        std::vector<uint32_t> frontier = forEachChunk(table.indexer.size(), [&](uint64_t begin, uint64_t end, std::vector<uint32_t>& found) {
+            Board board;
+            for (uint64_t i = begin; i < end; i++) {
+                if (!table.indexer.decode(i, board)) {
+                    table.values[i] = tb::INVALID;
+                    continue;
+                }
+
+                MoveList moves = board.generateLegalMoves();
+                if (moves.size() == 0) {
+                    bool inCheck = board.bitboards[board.state.activeColor][KING]
+                                   & board.getAttacks(oppositeSide(board.state.activeColor));
+                    table.values[i] = inCheck ? tb::lossIn(0) : tb::DRAW;
+                    if (inCheck) found.push_back((uint32_t) i);
+                    continue;
+                }
+
+                int winPly = 0;
+                int lossPly = 0;
+                bool drawn = false;
+                for (const Move& move : moves) {
+                    uint64_t target = getMask(move.to) & board.occupiedSquares[oppositeSide(board.state.activeColor)];
+                    if (!target && move.promotionType == INVALID_PIECE) continue;
+
+                    UnmakeMove unmake = board.makeMove(move);
+                    int8_t value = childValue(board, material, table);
+                    board.unmakeMove(unmake);
+
+                    if (value == tb::DRAW) {
+                        drawn = true;
+                    } else if (value < 0) {
+                        int ply = tb::pliesToMate(value) + 1;
+                        winPly = winPly ? std::min(winPly, ply) : ply;
+                    } else {
+                        lossPly = std::max(lossPly, tb::pliesToMate(value) + 1);
+                    }
+                }
+                externalPly[i] = (uint8_t) (winPly ? winPly : drawn ? 0 : lossPly);
+            }
+        });
+
+        bool externalAt[256] = {};
+        int lastExternal = 0;
+        for (uint8_t ply : externalPly) {
+            externalAt[ply] = true;
+            lastExternal = std::max<int>(lastExternal, ply);
+        }
+
+        // level n decides the positions that take exactly n plies. on odd levels a position wins if a move
+        // reaches a position lost in n - 1 plies, on even levels it is lost once every move reaches a
+        // position won in fewer than n plies. either way the deciding child was found on level n - 1 or
+        // is in another table, so only the parents of the last level's positions (found by un-moving
+        // their last move) and the positions whose externalPly is n are looked at. the positions a level
+        // decides are never children it reads, so the threads write them in place
+        int ply = 0;
+        while (!frontier.empty() || ply < lastExternal) {
+            ply++;
+            if (ply > 2 * tb::MAX_DTM + 1) {
+                std::cerr << material.name() << ": mates longer than " << tb::MAX_DTM << " moves can't be stored" << std::endl;
+                std::exit(1);
+            }
+
+            bool winning = ply % 2 == 1;
+            int8_t decided = winning ? tb::winIn((ply + 1) / 2) : tb::lossIn(ply / 2);
+
+            // a level's positions are all lost (odd levels follow) or all won, so a parent of a lost
+            // position simply wins, while the parent of a won one has to check its other moves
+            auto resolve = [&](uint64_t i, Board& board, std::vector<uint32_t>& found) {
+                std::atomic_ref<int8_t> value(table.values[i]);
+                if (value.load(std::memory_order_relaxed) != UNKNOWN) return;
+                if (!winning) {
+                    table.indexer.decode(i, board);
+                    if (!isLost(board, ply, material, table)) return;
+                }
+
+                int8_t expected = UNKNOWN;
+                if (value.compare_exchange_strong(expected, decided, std::memory_order_relaxed)) found.push_back((uint32_t) i);
+            };
+
+            std::vector<uint32_t> next = forEachChunk(frontier.size(), [&](uint64_t begin, uint64_t end, std::vector<uint32_t>& found) {
+                Board board;
+                Board parent;
+                for (uint64_t k = begin; k < end; k++) {
+                    table.indexer.decode(frontier[k], board);
+                    forEachParent(table.indexer, board, [&](uint64_t i) { resolve(i, parent, found); });
+                }
+            });
+
+            if (externalAt[ply]) {
+                std::vector<uint32_t> more = forEachChunk(table.indexer.size(), [&](uint64_t begin, uint64_t end, std::vector<uint32_t>& found) {
+                    Board board;
+                    for (uint64_t i = begin; i < end; i++) {
+                        if (externalPly[i] == ply) resolve(i, board, found);
+                    }
+                });
+                next.insert(next.end(), more.begin(), more.end());
+            }
+
+            frontier = std::move(next);
+        }
+
+        // whatever is left can't be forced either way
+        uint64_t counts[3] = {};
+        int longest = 0;
+        for (int8_t& value : table.values) {
+            if (value == UNKNOWN) value = tb::DRAW;
+            if (value == tb::INVALID) continue;
+
+            counts[value > 0 ? 0 : value == tb::DRAW ? 1 : 2]++;
+            if (value != tb::DRAW) longest = std::max(longest, tb::pliesToMate(value));
+        }
+
+        std::vector<int8_t> wdl(table.values.size());
+        std::transform(table.values.begin(), table.values.end(), wdl.begin(), [](int8_t value) {
+            return value == tb::INVALID ? value : (int8_t) ((value > 0) - (value < 0));
+        });
+
+        if (!tb::writeTable(path(material, ".dtm"), table.values) || !tb::writeTable(path(material, ".wdl"), wdl)) {
+            std::cerr << "could not write " << path(material, ".wdl") << std::endl;
+            std::exit(1);
+        }
+
+        std::cout << material.name() << ": " << counts[0] << " wins, " << counts[1] << " draws, " << counts[2]
+                  << " losses, longest mate " << longest << " plies, " << ply << " levels, "
+                  << secondsSince(start) << "s" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<Material> materials;
+    std::string directory = ".";
+    size_t threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+
+        if (arg == "--out" && i + 1 < argc) {
+            directory = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            std::optional<size_t> count = choco::util::parseNumber<size_t>(argv[++i]);
+            if (!count || *count == 0) {
+                printUsage();
+                return 1;
+            }
+            threads = *count;
+        } else if (arg == "--all" && i + 1 < argc) {
+            std::optional<int> pieces = choco::util::parseNumber<int>(argv[++i]);
+            if (!pieces || *pieces < 3 || *pieces > choco::tb::MAX_PIECES) {
+                printUsage();
+                return 1;
+            }
+            for (const Material& material : allMaterials(*pieces)) materials.push_back(material);
+        } else if (std::optional<Material> material = Material::parse(arg); material && material->pieceCount() > 2) {
+            materials.push_back(material->canonical());
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (materials.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    choco::initBitboards();
+
+    Generator generator(directory, threads);
+    for (const Material& material : materials) generator.require(material);
+
+    return 0;
+}
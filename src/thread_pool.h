@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace choco {
+    // Fixed-size pool of worker threads fed from a single FIFO queue. Tasks are independent jobs
+    // (perft subtrees, suite positions, games), so one queue is plenty.
+    class ThreadPool {
+    public:
+        // 0 picks one worker per hardware thread
+        explicit ThreadPool(size_t threads = 0) {
+            if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+            workers.reserve(threads);
+            for (size_t i = 0; i < threads; i++) {
+                workers.emplace_back([this]() { workerLoop(); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            available.notify_all();
+            for (std::thread& worker : workers) worker.join();
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t size() const {
+            return workers.size();
+        }
+
+        template<typename F>
+        std::future<std::invoke_result_t<F>> submit(F&& task) {
+            using Result = std::invoke_result_t<F>;
+
+            // packaged_task is move-only, std::function needs a copyable target
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+            std::future<Result> result = packaged->get_future();
+
+            {
+                std::lock_guard lock(mutex);
+                tasks.emplace_back([packaged]() { (*packaged)(); });
+            }
+            available.notify_one();
+
+            return result;
+        }
+    private:
+        void workerLoop() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(mutex);
+                    available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    if (tasks.empty()) return;
+
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable available;
+        bool stopping = false;
+    };
+} // namespace choco
@@ -0,0 +1,35 @@
+#include "tt.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace choco {
+    TranspositionTable::TranspositionTable(size_t megabytes) {
+        resize(megabytes);
+    }
+
+    TranspositionTable::~TranspositionTable() {
+        delete[] entries;
+    }
+
+    void TranspositionTable::resize(size_t megabytes) {
+        megabytes = std::clamp<size_t>(megabytes, 1, MAX_MB);
+        size_t count = std::bit_floor(megabytes * 1024 * 1024 / sizeof(Slot));
+
+        if (count != entryCount) {
+            delete[] entries;
+            entries = new Slot[count];
+            entryCount = count;
+            mask = count - 1;
+        }
+
+        clear();
+    }
+
+    void TranspositionTable::clear() {
+        for (size_t i = 0; i < entryCount; i++) {
+            entries[i].check.store(0, std::memory_order_relaxed);
+            entries[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+} // namespace choco
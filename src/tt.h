@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "types.h"
+
+namespace choco {
+    enum TTFlag : uint8_t { TT_EXACT, TT_ALPHA, TT_BETA };
+
+    static constexpr float NO_STATIC_EVAL = 1e9f;
+
+    struct TTEntry {
+        uint64_t key = 0;
+        float eval = 0;
+        float staticEval = NO_STATIC_EVAL;
+        int depth = -1;
+        TTFlag flag = TT_EXACT;
+        Move bestMove;
+    };
+
+    // Direct-mapped transposition table with a power-of-two number of entries, shared by every
+    // search thread without locking. Each slot packs an entry into one data word and stores it
+    // next to key ^ data, so a slot torn by a concurrent write fails the key check instead of
+    // handing out another position's score (as PerftTable does). The low 16 bits of the check
+    // word carry the static eval instead of key bits; the slot index already implies those.
+    class TranspositionTable {
+    public:
+        static constexpr size_t DEFAULT_MB = 128;
+        static constexpr size_t MAX_MB = 65536;
+
+        explicit TranspositionTable(size_t megabytes = DEFAULT_MB);
+        ~TranspositionTable();
+
+        TranspositionTable(const TranspositionTable&) = delete;
+        TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+        // reallocates to the largest power of two entries fitting in the given size; clears the table
+        void resize(size_t megabytes);
+        void clear();
+
+        size_t size() const { return entryCount; }
+
+        void store(uint64_t key, float eval, float staticEval, int depth, TTFlag flag, const Move& bestMove) {
+            Slot& slot = entries[key & mask];
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            bool sameKey = ((slot.check.load(std::memory_order_relaxed) ^ data ^ key) >> 16) == 0;
+
+            if (!sameKey || depth >= unpackDepth(data)) {
+                data = pack(eval, depth, flag, bestMove);
+                slot.data.store(data, std::memory_order_relaxed);
+                slot.check.store(key ^ data ^ packStaticEval(staticEval), std::memory_order_relaxed);
+            }
+        }
+
+        // false if the slot holds another position. The caller checks out.depth, since the static
+        // eval and the move are useful at any depth
+        bool lookup(uint64_t key, TTEntry& out) const {
+            const Slot& slot = entries[key & mask];
+            uint64_t data = slot.data.load(std::memory_order_relaxed);
+            uint64_t extra = slot.check.load(std::memory_order_relaxed) ^ data ^ key;
+
+            if ((extra >> 16) != 0 || unpackDepth(data) < 0) return false;
+            out.key = key;
+            out.eval = std::bit_cast<float>((uint32_t) data);
+            out.staticEval = (int16_t) extra == NO_STATIC_EVAL_BITS ? NO_STATIC_EVAL : (int16_t) extra / 100.f;
+            out.depth = unpackDepth(data);
+            out.flag = (TTFlag) ((data >> 40) & 3);
+            out.bestMove = Move((data >> 54) & 7, (data >> 42) & 63, (data >> 48) & 63, (data >> 57) & 7);
+            return true;
+        }
+    private:
+        // bits 0-31 eval, 32-39 depth + 1 (0 for an empty slot), 40-41 flag, 42-47 from, 48-53 to,
+        // 54-56 piece, 57-59 promotion
+        static uint64_t pack(float eval, int depth, TTFlag flag, const Move& move) {
+            return (uint64_t) std::bit_cast<uint32_t>(eval)
+                   | (uint64_t) (uint8_t) (depth + 1) << 32
+                   | (uint64_t) flag << 40
+                   | (uint64_t) (move.from & 63) << 42
+                   | (uint64_t) (move.to & 63) << 48
+                   | (uint64_t) (move.pieceType & 7) << 54
+                   | (uint64_t) (move.promotionType & 7) << 57;
+        }
+
+        // static evals are whole centipawns
+        static constexpr int16_t NO_STATIC_EVAL_BITS = std::numeric_limits<int16_t>::min();
+
+        static uint64_t packStaticEval(float staticEval) {
+            if (staticEval == NO_STATIC_EVAL) return (uint16_t) NO_STATIC_EVAL_BITS;
+            return (uint16_t) (int16_t) std::clamp<long>(std::lround(staticEval * 100), -32767, 32767);
+        }
+
+        static int unpackDepth(uint64_t data) {
+            return (int) ((data >> 32) & 0xFF) - 1;
+        }
+
+        struct Slot {
+            std::atomic<uint64_t> check{0};
+            std::atomic<uint64_t> data{0};
+        };
+
+        Slot* entries = nullptr;
+        size_t entryCount = 0;
+        uint64_t mask = 0;
+    };
+} // namespace choco
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bithelpers.h"
+#include "board.h"
+#include "epd.h"
+#include "packed_position.h"
+#include "pawns.h"
+#include "psqt.h"
+#include "str_util.h"
+#include "thread_pool.h"
+
+namespace {
+    using namespace choco;
+
+    void printUsage() {
+        std::cerr << "usage: johnner_tune <dataset> [--epochs N] [--lr RATE] [--optimizer adam|gd] [--k K]\n"
+                  << "                    [--threads N] [--out FILE]\n"
+                  << "a .bin dataset holds johnner_datagen records; in any other file each line is a FEN\n"
+                  << "with the game result for white: 1-0, 0-1, 1/2-1/2, [1.0], [0.5], [0.0], or a trailing | 1.0 field"
+                  << std::endl;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // weights, in the order the tables are written out: material, then the midgame and endgame
+    // piece-square tables indexed like psqt.h (rank 8 first)
+    constexpr int MATERIAL = 0;
+    constexpr int MG_PST = MATERIAL + 6;
+    constexpr int EG_PST = MG_PST + 6 * 64;
+    constexpr int WEIGHT_COUNT = EG_PST + 6 * 64;
+
+    constexpr double PST_SCALE = (double) PST_WEIGHT_NUM / PST_WEIGHT_DEN;
+
+    // A position reduced to what the tuned terms see. Each piece is one feature, the table index
+    // of the piece on its square with the sign bit set for black; material, both tables and the
+    // phase blend follow from it. Pawn structure and king shield are kept as a fixed score.
+    struct Entry {
+        uint32_t firstFeature;
+        uint8_t featureCount;
+        uint8_t phase;
+        int16_t fixedMg;
+        int16_t fixedEg;
+        float result;
+    };
+
+    constexpr uint16_t BLACK_FEATURE = 0x8000;
+
+    struct Dataset {
+        std::vector<Entry> entries;
+        std::vector<uint16_t> features;
+    };
+
+    // what follows the position: 1 for a white win, 0.5 for a draw, 0 for a black win
+    std::optional<float> parseResult(std::string_view line) {
+        if (line.find("1/2-1/2") != std::string_view::npos) return 0.5f;
+        if (line.find("1-0") != std::string_view::npos) return 1.f;
+        if (line.find("0-1") != std::string_view::npos) return 0.f;
+
+        std::string_view field;
+        size_t open = line.find('[');
+        size_t bar = line.rfind('|');
+        if (open != std::string_view::npos) {
+            size_t close = line.find(']', open);
+            if (close == std::string_view::npos) return std::nullopt;
+            field = line.substr(open + 1, close - open - 1);
+        } else if (bar != std::string_view::npos) {
+            field = util::trim(line.substr(bar + 1));
+        } else {
+            return std::nullopt;
+        }
+
+        std::optional<float> result = util::parseNumber<float>(field);
+        if (!result || *result < 0 || *result > 1) return std::nullopt;
+        return result;
+    }
+
+    void addPosition(Dataset& dataset, const Board& board, float result) {
+        Entry entry{};
+        entry.firstFeature = (uint32_t) dataset.features.size();
+        entry.phase = (uint8_t) std::min<int>(board.phase, MAX_PHASE);
+        entry.result = result;
+
+        PawnEntry pawns;
+        Score fixed = evaluatePawnStructure(board, pawns) + evaluateKingShield(board);
+        entry.fixedMg = (int16_t) mgValue(fixed);
+        entry.fixedEg = (int16_t) egValue(fixed);
+
+        for (uint8_t side = 0; side < 2; side++) {
+            for (uint8_t piece = 0; piece < 6; piece++) {
+                iterateIndices(board.bitboards[side][piece], [&](uint8_t square) {
+                    // same flip as detail::makePsqt
+                    uint8_t idx = (side == SIDE_WHITE) ? square ^ 56 : square;
+                    uint16_t feature = (uint16_t) (piece * 64 + idx);
+                    dataset.features.push_back(side == SIDE_WHITE ? feature : feature | BLACK_FEATURE);
+                });
+            }
+        }
+
+        entry.featureCount = (uint8_t) (dataset.features.size() - entry.firstFeature);
+        dataset.entries.push_back(entry);
+    }
+
+    bool loadPacked(const std::string& path, Dataset& dataset) {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file) return false;
+
+        std::vector<PackedPosition> block(1 << 14);
+        while (size_t count = std::fread(block.data(), sizeof(PackedPosition), block.size(), file)) {
+            for (size_t i = 0; i < count; i++) {
+                addPosition(dataset, unpackPosition(block[i]), resultForWhite(block[i]));
+            }
+        }
+
+        std::fclose(file);
+        return true;
+    }
+
+    bool loadDataset(const std::string& path, Dataset& dataset) {
+        if (path.ends_with(".bin")) return loadPacked(path, dataset);
+
+        epd::Reader reader;
+        if (!reader.open(path)) return false;
+
+        uint64_t skipped = 0;
+        Board board;
+        epd::Record record;
+        while (reader.next(record)) {
+            std::optional<float> result = parseResult(record.operations);
+            if (!result || !board.loadFen(record.fen)) {
+                skipped++;
+                continue;
+            }
+
+            addPosition(dataset, board, *result);
+        }
+
+        if (skipped) std::cerr << "skipped " << skipped << " unreadable lines" << std::endl;
+        return true;
+    }
+
+    std::vector<double> initialWeights() {
+        std::vector<double> weights(WEIGHT_COUNT);
+        for (int piece = 0; piece < 6; piece++) {
+            weights[MATERIAL + piece] = PIECE_VALUES_CP[piece];
+            for (int idx = 0; idx < 64; idx++) {
+                weights[MG_PST + piece * 64 + idx] = MG_PIECE_SQUARE_TABLES[piece][idx];
+                weights[EG_PST + piece * 64 + idx] = EG_PIECE_SQUARE_TABLES[piece][idx];
+            }
+        }
+        return weights;
+    }
+
+    // centipawns from white's point of view, as evaluateUncached computes it without rounding
+    double evaluate(const Dataset& dataset, const Entry& entry, const std::vector<double>& weights) {
+        double mgWeight = entry.phase / (double) MAX_PHASE;
+
+        double material = 0;
+        double mg = entry.fixedMg;
+        double eg = entry.fixedEg;
+        for (uint32_t i = 0; i < entry.featureCount; i++) {
+            uint16_t feature = dataset.features[entry.firstFeature + i];
+            uint16_t index = feature & ~BLACK_FEATURE;
+            double sign = (feature & BLACK_FEATURE) ? -1 : 1;
+
+            material += sign * weights[MATERIAL + index / 64];
+            mg += sign * PST_SCALE * weights[MG_PST + index];
+            eg += sign * PST_SCALE * weights[EG_PST + index];
+        }
+        return material + mg * mgWeight + eg * (1 - mgWeight);
+    }
+
+    // expected result for white, 1 / (1 + 10^(-k * eval / 400))
+    double sigmoid(double k, double eval) {
+        return 1 / (1 + std::exp(-k * eval * std::log(10.0) / 400));
+    }
+
+    // mean squared error of the predicted results, or its gradient when gradient isn't null.
+    // each pool thread takes a slice of the positions and the partial sums are added at the end
+    double loss(const Dataset& dataset, const std::vector<double>& weights, double k, ThreadPool& pool,
+                std::vector<double>* gradient = nullptr) {
+        size_t slices = pool.size();
+        size_t sliceSize = (dataset.entries.size() + slices - 1) / slices;
+
+        struct Partial {
+            double error = 0;
+            std::vector<double> gradient;
+        };
+
+        std::vector<std::future<Partial>> futures;
+        for (size_t slice = 0; slice < slices; slice++) {
+            size_t begin = std::min(slice * sliceSize, dataset.entries.size());
+            size_t end = std::min(begin + sliceSize, dataset.entries.size());
+
+            futures.push_back(pool.submit([&, begin, end]() {
+                Partial partial;
+                if (gradient) partial.gradient.assign(WEIGHT_COUNT, 0);
+
+                for (size_t i = begin; i < end; i++) {
+                    const Entry& entry = dataset.entries[i];
+                    double predicted = sigmoid(k, evaluate(dataset, entry, weights));
+                    double difference = predicted - entry.result;
+                    partial.error += difference * difference;
+
+                    if (!gradient) continue;
+
+                    // d/dw (p - r)^2 = 2 (p - r) p (1 - p) k ln(10) / 400 * d eval/dw
+                    double scale = 2 * difference * predicted * (1 - predicted) * k * std::log(10.0) / 400;
+                    double mgWeight = entry.phase / (double) MAX_PHASE;
+                    for (uint32_t j = 0; j < entry.featureCount; j++) {
+                        uint16_t feature = dataset.features[entry.firstFeature + j];
+                        uint16_t index = feature & ~BLACK_FEATURE;
+                        double signedScale = (feature & BLACK_FEATURE) ? -scale : scale;
+
+                        partial.gradient[MATERIAL + index / 64] += signedScale;
+                        partial.gradient[MG_PST + index] += signedScale * PST_SCALE * mgWeight;
+                        partial.gradient[EG_PST + index] += signedScale * PST_SCALE * (1 - mgWeight);
+                    }
+                }
+                return partial;
+            }));
+        }
+
+        double error = 0;
+        if (gradient) gradient->assign(WEIGHT_COUNT, 0);
+        for (auto& future : futures) {
+            Partial partial = future.get();
+            error += partial.error;
+            if (!gradient) continue;
+            for (int w = 0; w < WEIGHT_COUNT; w++) (*gradient)[w] += partial.gradient[w];
+        }
+
+        double n = (double) std::max<size_t>(dataset.entries.size(), 1);
+        if (gradient) {
+            for (double& g : *gradient) g /= n;
+        }
+        return error / n;
+    }
+
+    // the scaling constant that best fits the current evaluation to the results, by golden section search
+    double fitK(const Dataset& dataset, const std::vector<double>& weights, ThreadPool& pool) {
+        const double ratio = (std::sqrt(5.0) - 1) / 2;
+        double low = 0.1;
+        double high = 3;
+
+        double a = high - ratio * (high - low);
+        double b = low + ratio * (high - low);
+        double lossA = loss(dataset, weights, a, pool);
+        double lossB = loss(dataset, weights, b, pool);
+
+        for (int i = 0; i < 30; i++) {
+            if (lossA < lossB) {
+                high = b;
+                b = a;
+                lossB = lossA;
+                a = high - ratio * (high - low);
+                lossA = loss(dataset, weights, a, pool);
+            } else {
+                low = a;
+                a = b;
+                lossA = lossB;
+                b = low + ratio * (high - low);
+                lossB = loss(dataset, weights, b, pool);
+            }
+        }
+        return (low + high) / 2;
+    }
+
+    void writeTable(std::ostream& out, const char* name, const std::vector<double>& weights, int offset) {
+        static constexpr const char* PIECE_NAMES[6] = { "king", "queen", "bishop", "knight", "rook", "pawn" };
+
+        out << "    static constexpr int16_t " << name << "[6][64] = {\n";
+        for (int piece = 0; piece < 6; piece++) {
+            out << "        { // " << PIECE_NAMES[piece] << "\n";
+            for (int rank = 0; rank < 8; rank++) {
+                out << "           ";
+                for (int file = 0; file < 8; file++) {
+                    char value[16];
+                    std::snprintf(value, sizeof(value), " %4d,", (int) std::lround(weights[offset + piece * 64 + rank * 8 + file]));
+                    out << value;
+                }
+                out << "\n";
+            }
+            out << "        },\n";
+        }
+        out << "    };\n";
+    }
+
+    // drop-in replacements for the tables in psqt.h
+    void writeTables(std::ostream& out, const std::vector<double>& weights) {
+        out << "    static constexpr int16_t PIECE_VALUES_CP[6] = {\n        ";
+        for (int piece = 0; piece < 6; piece++) {
+            // the king is on the board in every position, its material can't be told apart from zero
+            int value = piece == KING ? 0 : (int) std::lround(weights[MATERIAL + piece]);
+            out << value << (piece < 5 ? ", " : "\n");
+        }
+        out << "    };\n\n";
+
+        writeTable(out, "MG_PIECE_SQUARE_TABLES", weights, MG_PST);
+        out << "\n";
+        writeTable(out, "EG_PIECE_SQUARE_TABLES", weights, EG_PST);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string datasetPath;
+    std::string outPath;
+    int epochs = 1000;
+    std::optional<double> learningRate;
+    bool adam = true;
+    std::optional<double> fixedK;
+    size_t threads = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool ok = true;
+
+        if (arg == "--epochs" && i + 1 < argc) {
+            std::optional<int> value = util::parseNumber<int>(argv[++i]);
+            ok = value && *value >= 0;
+            if (ok) epochs = *value;
+        } else if (arg == "--lr" && i + 1 < argc) {
+            std::optional<double> value = util::parseNumber<double>(argv[++i]);
+            ok = value && *value > 0;
+            if (ok) learningRate = value;
+        } else if (arg == "--optimizer" && i + 1 < argc) {
+            std::string_view value = argv[++i];
+            ok = value == "adam" || value == "gd";
+            adam = value == "adam";
+        } else if (arg == "--k" && i + 1 < argc) {
+            fixedK = util::parseNumber<double>(argv[++i]);
+            ok = fixedK && *fixedK > 0;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            std::optional<size_t> value = util::parseNumber<size_t>(argv[++i]);
+            ok = value && *value > 0;
+            if (ok) threads = *value;
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (!arg.starts_with("--") && datasetPath.empty()) {
+            datasetPath = arg;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (datasetPath.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    initBitboards();
+
+    auto start = std::chrono::steady_clock::now();
+    Dataset dataset;
+    if (!loadDataset(datasetPath, dataset) || dataset.entries.empty()) {
+        std::cerr << "no positions in " << datasetPath << std::endl;
+        return 1;
+    }
+    std::cerr << "loaded " << dataset.entries.size() << " positions in " << secondsSince(start) << "s" << std::endl;
+
+    ThreadPool pool(threads);
+    std::vector<double> weights = initialWeights();
+
+    double k = fixedK ? *fixedK : fitK(dataset, weights, pool);
+    std::cerr << "k " << k << ", initial loss " << loss(dataset, weights, k, pool) << std::endl;
+
+    // the learning rate is in centipawns per step for Adam; plain gradient descent scales the raw gradient,
+    // which is tiny for a mean squared error of results
+    const double rate = learningRate ? *learningRate : adam ? 1 : 100000;
+    constexpr double BETA1 = 0.9;
+    constexpr double BETA2 = 0.999;
+    constexpr double EPSILON = 1e-8;
+    std::vector<double> gradient;
+    std::vector<double> momentum(WEIGHT_COUNT, 0);
+    std::vector<double> velocity(WEIGHT_COUNT, 0);
+
+    start = std::chrono::steady_clock::now();
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        double error = loss(dataset, weights, k, pool, &gradient);
+
+        for (int w = 0; w < WEIGHT_COUNT; w++) {
+            if (adam) {
+                momentum[w] = BETA1 * momentum[w] + (1 - BETA1) * gradient[w];
+                velocity[w] = BETA2 * velocity[w] + (1 - BETA2) * gradient[w] * gradient[w];
+                double m = momentum[w] / (1 - std::pow(BETA1, epoch));
+                double v = velocity[w] / (1 - std::pow(BETA2, epoch));
+                weights[w] -= rate * m / (std::sqrt(v) + EPSILON);
+            } else {
+                weights[w] -= rate * gradient[w];
+            }
+        }
+        weights[MATERIAL + KING] = 0;
+
+        if (epoch % 50 == 0 || epoch == epochs) {
+            std::cerr << "epoch " << epoch << " loss " << error << " (" << secondsSince(start) << "s)" << std::endl;
+        }
+    }
+
+    std::cerr << "final loss " << loss(dataset, weights, k, pool) << std::endl;
+
+    if (outPath.empty()) {
+        writeTables(std::cout, weights);
+    } else {
+        std::ofstream out(outPath);
+        writeTables(out, weights);
+        if (!out) {
+            std::cerr << "could not write " << outPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -1,47 +1,204 @@
 #include "uci.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
-#include <vector>
+#include <limits>
 #include <string>
 
 #include "str_util.h"
 #include "macros.h"
+#include "perft.h"
+#include "tablebase.h"
 
 namespace choco {
-    UciInstance::UciInstance() : search(Board()) { }
+    namespace {
+        constexpr int BENCH_DEPTH = 7;
+    }
+
+    void UciOptions::add(Option option) {
+        option.value = option.defaultVal;
+        options.push_back(std::move(option));
+    }
+
+    UciOptions::Option* UciOptions::find(std::string_view name) {
+        // option names are case-insensitive in UCI
+        for (Option& option : options) {
+            if (util::equalsIgnoreCase(option.name, name)) return &option;
+        }
+        return nullptr;
+    }
+
+    const UciOptions::Option* UciOptions::find(std::string_view name) const {
+        for (const Option& option : options) {
+            if (util::equalsIgnoreCase(option.name, name)) return &option;
+        }
+        return nullptr;
+    }
+
+    UciOptions::SetResult UciOptions::set(std::string_view name, std::string_view value) {
+        Option* option = find(name);
+        if (!option) return SetResult::UNKNOWN_OPTION;
+
+        switch (option->type) {
+            case Type::SPIN: {
+                std::optional<int64_t> number = util::parseNumber<int64_t>(value);
+                if (!number || *number < option->min || *number > option->max) return SetResult::INVALID_VALUE;
+                option->value = std::to_string(*number);
+                break;
+            }
+            case Type::CHECK:
+                if (value != "true" && value != "false") return SetResult::INVALID_VALUE;
+                option->value = value;
+                break;
+            case Type::BUTTON:
+                break;
+            case Type::STRING:
+                option->value = (value == "<empty>") ? std::string_view() : value;
+                break;
+        }
+
+        if (option->onChange) option->onChange(*option);
+        return SetResult::OK;
+    }
+
+    void addSearchOptions(UciOptions& options, Search& search) {
+        options.add({ "Hash", UciOptions::Type::SPIN, std::to_string(TranspositionTable::DEFAULT_MB),
+                      1, TranspositionTable::MAX_MB,
+                      [&search](const UciOptions::Option& o) { search.setHashSize(std::stoull(o.value)); } });
+        options.add({ "Threads", UciOptions::Type::SPIN, "1", 1, 256,
+                      [&search](const UciOptions::Option& o) { search.setThreads(std::stoi(o.value)); } });
+        options.add({ "Clear Hash", UciOptions::Type::BUTTON, "", 0, 0,
+                      [&search](const UciOptions::Option&) { search.clearTT(); } });
+        options.add({ "LateMoveReductions", UciOptions::Type::CHECK, "true", 0, 0,
+                      [&search](const UciOptions::Option& o) { search.options.lateMoveReductions = o.value == "true"; } });
+        options.add({ "DeltaPruning", UciOptions::Type::CHECK, "true", 0, 0,
+                      [&search](const UciOptions::Option& o) { search.options.deltaPruning = o.value == "true"; } });
+        options.add({ "ReverseFutility", UciOptions::Type::CHECK, "true", 0, 0,
+                      [&search](const UciOptions::Option& o) { search.options.reverseFutility = o.value == "true"; } });
+
+        for (const Tunable& tunable : TUNABLES) {
+            options.add({ tunable.name, UciOptions::Type::SPIN, std::to_string(SearchParams().*tunable.value),
+                          tunable.min, tunable.max, [&search, &tunable](const UciOptions::Option& o) {
+                              search.options.params.*tunable.value = std::stoi(o.value);
+                          } });
+        }
+    }
+
+    UciInstance::UciInstance() : search(Board()) {
+        lastPosition.reserve(4096);
 
-    void UciInstance::processLine(const std::string& line) {
-        std::vector<std::string> tokens = util::split(line, " ");
+        addSearchOptions(options, search);
+        // milliseconds kept in reserve per move for GUI and network latency
+        options.add({ "MoveOverhead", UciOptions::Type::SPIN, "10", 0, 5000 });
+        // Polyglot .bin book; go answers from it without searching while the position is in the book
+        options.add({ "BookFile", UciOptions::Type::STRING, "", 0, 0, [this](const UciOptions::Option& o) {
+            book.unload();
+            if (o.value.empty()) return;
 
-        if (tokens.empty()) {
+            if (book.load(o.value)) {
+                std::cout << "info string loaded book " << o.value << " (" << book.size() << " entries)" << std::endl;
+            } else {
+                std::cout << "info string could not load book " << o.value << std::endl;
+            }
+        } });
+        // always play the highest weighted book move instead of picking by weight
+        options.add({ "BestBookMove", UciOptions::Type::CHECK, "false" });
+        // directory of johnner_tbgen tables
+        options.add({ "TablebasePath", UciOptions::Type::STRING, "", 0, 0, [](const UciOptions::Option& o) {
+            tb::unload();
+            if (o.value.empty()) return;
+
+            int tables = tb::load(o.value);
+            std::cout << "info string loaded " << tables << " tablebases, up to " << tb::maxPieces() << " pieces" << std::endl;
+        } });
+    }
+
+    void UciInstance::processLine(std::string_view line) {
+        line = util::trim(line);
+
+        std::string_view rest = line;
+        std::string_view command = util::nextToken(rest);
+
+        if (command.empty()) {
             return;
         }
 
-        if (tokens[0] == "uci") {
+        if (command == "uci") {
             uci();
-        } else if (tokens[0] == "setoption") {
-            // setOption(line);
-        } else if (tokens[0] == "position") {
+        } else if (command == "setoption") {
+            setOption(rest);
+        } else if (command == "position") {
             position(line);
-        } else if (tokens[0] == "go") {
-            go(line);
-        } else if (tokens[0] == "stop") {
+        } else if (command == "go") {
+            go(rest);
+        } else if (command == "stop") {
             stop();
-        } else if (tokens[0] == "ponderhit") {
+        } else if (command == "ponderhit") {
 
-        } else if (tokens[0] == "ucinewgame") {
+        } else if (command == "ucinewgame") {
             uciNewGame();
-        } else if (tokens[0] == "isready") {
+        } else if (command == "isready") {
             isReady();
-        } else if (tokens[0] == "quit") {
+        } else if (command == "quit") {
             quit();
+        } else if (command == "stats") {
+            printStats(util::nextToken(rest) == "json");
+        } else if (command == "bench") {
+            bench(util::parseNumber<int>(util::nextToken(rest)).value_or(BENCH_DEPTH));
         }
     }
 
-    void UciInstance::go(const std::string& line) {
-        std::vector<std::string> lineSplit = util::split(line, " ");
+    void UciInstance::go(std::string_view line) {
+        int64_t moveTime = -1;
+        int64_t time[2] = { -1, -1 };
+        int64_t inc[2] = { 0, 0 };
+        int64_t movesToGo = 0;
+        int64_t depth = 0;
+        int64_t nodes = 0;
+
+        for (std::string_view token = util::nextToken(line); !token.empty(); token = util::nextToken(line)) {
+            if (token == "perft") {
+                PerftOptions perftOptions;
+                perftOptions.threads = options.get<int>("Threads");
+                perftOptions.hashMb = options.get<size_t>("Hash");
+                perftOptions.print = true;
+
+                perft(search.getBoard(), util::parseNumber<int>(util::nextToken(line)).value_or(1), perftOptions);
+                return;
+            }
+
+            int64_t* target = nullptr;
+            if (token == "movetime")       target = &moveTime;
+            else if (token == "wtime")     target = &time[SIDE_WHITE];
+            else if (token == "btime")     target = &time[SIDE_BLACK];
+            else if (token == "winc")      target = &inc[SIDE_WHITE];
+            else if (token == "binc")      target = &inc[SIDE_BLACK];
+            else if (token == "movestogo") target = &movesToGo;
+            else if (token == "depth")     target = &depth;
+            else if (token == "nodes")     target = &nodes;
+
+            if (target) *target = util::parseNumber<int64_t>(util::nextToken(line)).value_or(*target);
+        }
+
+        if (std::optional<Move> bookMove = book.probe(search.getBoard(), options.get<bool>("BestBookMove"))) {
+            std::cout << "bestmove " << moveToUci(*bookMove) << std::endl;
+            return;
+        }
+
+        uint8_t us = search.getBoard().state.activeColor;
+        if (moveTime < 0 && time[us] >= 0) {
+            moveTime = moveTimeBudget(time[us], inc[us], movesToGo);
+        } else if (moveTime < 0) {
+            // a depth or node limit alone runs until it is reached
+            moveTime = depth > 0 || nodes > 0 ? std::numeric_limits<int32_t>::max() : 10000;
+        }
+
         SearchBounds searchBounds = {};
-        searchBounds.moveTime = util::findElement<int64_t>(lineSplit, "movetime").value_or((int64_t)10000);
+        searchBounds.moveTime = std::max<int64_t>(moveTime - options.get<int64_t>("MoveOverhead"), 1);
+        searchBounds.depth = (int) std::clamp<int64_t>(depth, 0, 64);
+        searchBounds.nodes = (uint64_t) std::max<int64_t>(nodes, 0);
+
         search.search(searchBounds);
     }
 
@@ -53,43 +210,152 @@ namespace choco {
         search.stop();
     }
 
-    void applyOptions() {
-
-    }
-
     void UciInstance::uci() {
         std::cout << "id name Johnner_v1" << std::endl;
         std::cout << "id author chococaker\n" << std::endl;
-        for (const auto &[name, option]: options) {
-            std::cout << "option name " << name << " type " << option.type << " default "
-                        << option.defaultVal;
-            if (!option.min.empty()) {
-                std::cout << " min " << option.min << " max " << option.max;
+        for (const UciOptions::Option& option : options) {
+            std::cout << "option name " << option.name;
+            switch (option.type) {
+                case UciOptions::Type::SPIN:
+                    std::cout << " type spin default " << option.defaultVal
+                              << " min " << option.min << " max " << option.max;
+                    break;
+                case UciOptions::Type::CHECK:
+                    std::cout << " type check default " << option.defaultVal;
+                    break;
+                case UciOptions::Type::BUTTON:
+                    std::cout << " type button";
+                    break;
+                case UciOptions::Type::STRING:
+                    std::cout << " type string default " << (option.defaultVal.empty() ? "<empty>" : option.defaultVal);
+                    break;
             }
             std::cout << std::endl;
         }
         std::cout << "uciok" << std::endl;
     }
 
-    void UciInstance::position(const std::string& line) {
-        const int fenRange = util::findRange(line, "fen", "moves");
+    void UciInstance::position(std::string_view line) {
+        // GUIs resend the whole game every move. if this command only appends moves to the
+        // previous one, play just the new moves and keep the game history intact
+        if (!lastPosition.empty() && line.starts_with(lastPosition)) {
+            std::string_view newMoves = line.substr(lastPosition.size());
+
+            if (newMoves.empty() || newMoves[0] == ' ') {
+                if (playMoves(newMoves)) lastPosition.assign(line);
+                else lastPosition.clear();
+                return;
+            }
+        }
+
+        std::string_view rest = line;
+        util::nextToken(rest); // "position"
+
+        std::string_view type = util::nextToken(rest);
+        std::string_view fen = STARTING_POS;
+
+        if (type == "fen") {
+            size_t movesPos = rest.find(" moves");
+            fen = util::trim(rest.substr(0, movesPos));
+            rest = (movesPos == std::string_view::npos) ? std::string_view() : rest.substr(movesPos);
+        }
+
+        Board board;
+        const char* error = nullptr;
+        if (!board.loadFen(fen, &error)) {
+            std::cout << "info string invalid fen: " << error << std::endl;
+            return;
+        }
+        search.setBoard<false>(board);
+
+        if (playMoves(rest)) lastPosition.assign(line);
+        else lastPosition.clear();
+    }
+
+    bool UciInstance::playMoves(std::string_view moves) {
+        for (std::string_view token = util::nextToken(moves); !token.empty(); token = util::nextToken(moves)) {
+            if (token == "moves") continue;
 
-        const std::string fen = (line.contains("fen"))
-                                ? line.substr(line.find("fen") + 4, fenRange)
-                                : STARTING_POS;
+            std::optional<Move> move = legalUciMove(search.getBoard(), token);
+            if (!move) {
+                std::cout << "info string illegal move: " << token << std::endl;
+                return false;
+            }
+            search.playMove(*move);
+        }
+        return true;
+    }
 
-        const std::string moves = line.contains("moves") ? line.substr(line.find("moves") + 6) : "";
-        const std::vector<std::string> moveVec = util::split(moves, " ");
+    void UciInstance::setOption(std::string_view line) {
+        // setoption name <id> [value <x>], where the id may contain spaces
+        if (util::nextToken(line) != "name") return;
 
-        search.setBoard<false>(fen);
+        std::string_view name = util::trim(line);
+        std::string_view value;
 
-        for (const std::string& move : moveVec) {
-            search.playMove(uciToMove(search.getBoard(), move));
+        size_t valuePos = name.find(" value");
+        if (valuePos != std::string_view::npos) {
+            value = util::trim(name.substr(valuePos + 6));
+            name = util::trim(name.substr(0, valuePos));
+        }
+
+        switch (options.set(name, value)) {
+            case UciOptions::SetResult::OK:
+                break;
+            case UciOptions::SetResult::UNKNOWN_OPTION:
+                std::cout << "info string unknown option " << name << std::endl;
+                break;
+            case UciOptions::SetResult::INVALID_VALUE:
+                std::cout << "info string invalid value for option " << name << std::endl;
+                break;
         }
     }
 
     void UciInstance::uciNewGame() {
         search.clearTT();
+        lastPosition.clear();
+    }
+
+    void UciInstance::bench(int depth) {
+        search.clearTT();
+
+        SearchBounds searchBounds = {};
+        searchBounds.moveTime = std::numeric_limits<int32_t>::max();
+        searchBounds.depth = std::max(depth, 1);
+
+        uint64_t nodes = 0;
+#ifdef BOT_PERF_COUNTERS
+        PerfSample perfTotal;
+#endif
+        auto start = std::chrono::steady_clock::now();
+
+        for (const char* fen : BENCH_POSITIONS) {
+            search.setBoard<false>(Board(fen));
+            search.search(searchBounds);
+            nodes += search.getNodes();
+#ifdef BOT_PERF_COUNTERS
+            perfTotal += search.getPerfSample();
+#endif
+        }
+
+        int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "info string bench depth " << searchBounds.depth << " nodes " << nodes << " time " << ms
+                  << " nps " << nodes * 1000 / std::max<int64_t>(ms, 1) << std::endl;
+#ifdef BOT_PERF_COUNTERS
+        std::cout << perfTotal.toString(nodes) << std::endl;
+#endif
+
+        // the board no longer matches the last position command
+        lastPosition.clear();
+    }
+
+    void UciInstance::printStats(bool json) {
+#ifdef BOT_SEARCH_STATS
+        const SearchStats& stats = search.getStats();
+        std::cout << (json ? "info string " + stats.toJson() : stats.toString()) << std::endl;
+#else
+        std::cout << "info string stats unavailable, build with JOHNNER_SEARCH_STATS=ON" << std::endl;
+#endif
     }
 
     void UciInstance::isReady() {
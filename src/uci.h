@@ -1,81 +1,121 @@
 #pragma once
 
+#include <algorithm>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
+#include <functional>
 #include <cstdint>
+#include <optional>
 
+#include "book.h"
 #include "search.h"
 #include "bithelpers.h"
+#include "str_util.h"
 
 namespace choco {
     class UciOptions {
     public:
+        enum class Type { SPIN, CHECK, BUTTON, STRING };
+
         struct Option {
             std::string name;
-            std::string type;
-            std::string value;
+            Type type;
             std::string defaultVal;
-            std::string min;
-            std::string max;
+            int64_t min = 0;
+            int64_t max = 0;
+            // called with the new value after a successful setoption; buttons are called with no value
+            std::function<void(const Option&)> onChange;
+            std::string value;
         };
 
+        void add(Option option);
+
+        enum class SetResult { OK, UNKNOWN_OPTION, INVALID_VALUE };
+        // checks value against the option's type and range before storing it and calling onChange
+        SetResult set(std::string_view name, std::string_view value);
+
         template<typename T>
-        T get(const std::string &name);
+        T get(std::string_view name) const;
 
-        std::unordered_map<std::string, choco::UciOptions::Option>::iterator begin() {
+        std::vector<Option>::const_iterator begin() const {
             return options.begin();
         }
-        std::unordered_map<std::string, choco::UciOptions::Option>::iterator end() {
+        std::vector<Option>::const_iterator end() const {
             return options.end();
         }
     private:
-        std::unordered_map<std::string,  Option> options;
+        Option* find(std::string_view name);
+        const Option* find(std::string_view name) const;
+
+        // kept in insertion order so the uci command lists them predictably
+        std::vector<Option> options;
     };
 
+    // the options that configure a search (hash, threads, search features), bound to search
+    void addSearchOptions(UciOptions& options, Search& search);
+
+    // milliseconds to spend on a move: an even share of the clock over movesToGo moves (30 when
+    // unknown) plus most of the increment
+    inline int64_t moveTimeBudget(int64_t time, int64_t increment, int64_t movesToGo) {
+        return std::min(time / (movesToGo > 0 ? movesToGo : 30) + increment * 3 / 4, time);
+    }
+
     class UciInstance {
     public:
         UciInstance();
 
         void loop();
-        void processLine(const std::string& line);
+        void processLine(std::string_view line);
     private:
-        void applyOptions();
-
         // commands
         void uci();
-        void position(const std::string& line);
+        void position(std::string_view line);
         void uciNewGame();
-        void go(const std::string& line);
+        void go(std::string_view line);
         void quit();
         void stop();
         void isReady();
-        void setOption(const std::string& in);
+        void setOption(std::string_view line);
+
+        // plays the moves of a position command; false, after reporting it, at the first illegal one
+        bool playMoves(std::string_view moves);
+
+        // non-standard
+        void printStats(bool json);
+        // fixed-depth search over a fixed set of positions; prints total nodes and nps
+        void bench(int depth);
 
         UciOptions options;
         Search search;
+        OpeningBook book;
+
+        // the last position command, so a follow-up that only appends moves can be applied incrementally
+        std::string lastPosition;
     };
 
 
     template<typename T>
-    T UciOptions::get(const std::string &name) {
-        if constexpr (std::is_same_v<T, int>)
-            return std::stoi(options[name].value);
-        else if constexpr (std::is_same_v<T, float>)
-            return std::stof(options[name].value);
-        else if constexpr (std::is_same_v<T, uint64_t>)
-            return std::stoull(options[name].value);
-        else if constexpr (std::is_same_v<T, bool>)
-            return options[name].value == "true";
+    T UciOptions::get(std::string_view name) const {
+        const std::string& value = find(name)->value;
+        if constexpr (std::is_same_v<T, bool>)
+            return value == "true";
+        else if constexpr (std::is_arithmetic_v<T>)
+            return util::parseNumber<T>(value).value_or(T());
         else
-            return options[name].value;
+            return value;
     }
 
-    inline Move uciToMove(const Board& board, const std::string& str) {
-        std::string fromStr = str.substr(0, 2);
-        std::string toStr = str.substr(2, 2);
+    // the move in long algebraic notation, e.g. "e2e4" or "e7e8q"; its pieceType is INVALID_PIECE
+    // if the text isn't one. The move may still be illegal; see legalUciMove
+    inline Move uciToMove(const Board& board, std::string_view str) {
+        Move invalid = { INVALID_PIECE, INVALID_SQUARE, INVALID_SQUARE, INVALID_PIECE };
+        if (str.size() != 4 && str.size() != 5) return invalid;
+        if (str[0] < 'a' || str[0] > 'h' || str[1] < '1' || str[1] > '8'
+            || str[2] < 'a' || str[2] > 'h' || str[3] < '1' || str[3] > '8') return invalid;
 
-        uint8_t from = (fromStr[0] - 'a') + (fromStr[1] - '1') * 8;
-        uint8_t to = (toStr[0] - 'a') + (toStr[1] - '1') * 8;
+        uint8_t from = (str[0] - 'a') + (str[1] - '1') * 8;
+        uint8_t to = (str[2] - 'a') + (str[3] - '1') * 8;
 
         uint8_t pieceType = getPieceOnSquare(board.bitboards, from);
         
@@ -88,11 +128,23 @@ namespace choco {
             case 'n': move.promotionType = KNIGHT; break;
             case 'b': move.promotionType = BISHOP; break;
             case 'r': move.promotionType = ROOK;   break;
+            default: return invalid;
         };
 
         return move;
     }
 
+    // the legal move the text stands for, or nullopt
+    inline std::optional<Move> legalUciMove(const Board& board, std::string_view str) {
+        Move move = uciToMove(board, str);
+        if (!isValidPiece(move.pieceType)) return std::nullopt;
+
+        for (const Move& legal : board.generateLegalMoves()) {
+            if (legal == move) return legal;
+        }
+        return std::nullopt;
+    }
+
     inline std::string moveToUci(const Move& move) {
         std::string fromStr = std::string(1, (move.from % 8) + 'a') + std::to_string(move.from / 8 + 1);
         std::string toStr = std::string(1, (move.to % 8) + 'a') + std::to_string(move.to / 8 + 1);
@@ -0,0 +1,138 @@
+#include "uci_process.h"
+
+#include <chrono>
+
+#ifndef _WIN32
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace choco {
+    UciProcess::~UciProcess() {
+        stop();
+    }
+
+#ifdef _WIN32
+    bool UciProcess::start(const std::string&) {
+        return false;
+    }
+
+    void UciProcess::stop() { }
+
+    bool UciProcess::send(std::string_view) {
+        return false;
+    }
+
+    std::optional<std::string> UciProcess::readLine(int64_t) {
+        return std::nullopt;
+    }
+#else
+    bool UciProcess::start(const std::string& command) {
+        stop();
+
+        int toChild[2];
+        int fromChild[2];
+        if (pipe(toChild) != 0) return false;
+        if (pipe(fromChild) != 0) {
+            close(toChild[0]);
+            close(toChild[1]);
+            return false;
+        }
+
+        pid = fork();
+        if (pid == 0) {
+            dup2(toChild[0], STDIN_FILENO);
+            dup2(fromChild[1], STDOUT_FILENO);
+            close(toChild[0]);
+            close(toChild[1]);
+            close(fromChild[0]);
+            close(fromChild[1]);
+
+            execl("/bin/sh", "sh", "-c", ("exec " + command).c_str(), (char*) nullptr);
+            _exit(127);
+        }
+
+        close(toChild[0]);
+        close(fromChild[1]);
+        if (pid < 0) {
+            close(toChild[1]);
+            close(fromChild[0]);
+            return false;
+        }
+
+        input = toChild[1];
+        output = fromChild[0];
+        buffer.clear();
+
+        // a child that died must not kill us with SIGPIPE on the next write
+        signal(SIGPIPE, SIG_IGN);
+        return true;
+    }
+
+    void UciProcess::stop() {
+        if (pid <= 0) return;
+
+        send("quit");
+        close(input);
+
+        // give it a moment to exit cleanly
+        int status;
+        bool exited = false;
+        for (int i = 0; i < 50 && !exited; i++) {
+            exited = waitpid(pid, &status, WNOHANG) == pid;
+            if (!exited) usleep(10000);
+        }
+        if (!exited) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+        }
+
+        close(output);
+        pid = -1;
+        input = -1;
+        output = -1;
+    }
+
+    bool UciProcess::send(std::string_view line) {
+        if (pid <= 0) return false;
+
+        std::string data(line);
+        data += '\n';
+        for (size_t written = 0; written < data.size();) {
+            ssize_t n = write(input, data.data() + written, data.size() - written);
+            if (n <= 0) return false;
+            written += (size_t) n;
+        }
+        return true;
+    }
+
+    std::optional<std::string> UciProcess::readLine(int64_t timeoutMs) {
+        if (pid <= 0) return std::nullopt;
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        while (true) {
+            size_t newline = buffer.find('\n');
+            if (newline != std::string::npos) {
+                std::string line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                return line;
+            }
+
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) return std::nullopt;
+
+            pollfd descriptor = { output, POLLIN, 0 };
+            if (poll(&descriptor, 1, (int) remaining.count()) <= 0) continue;
+
+            char chunk[4096];
+            ssize_t n = read(output, chunk, sizeof(chunk));
+            if (n <= 0) return std::nullopt;
+            buffer.append(chunk, (size_t) n);
+        }
+    }
+#endif
+} // namespace choco
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace choco {
+    // A child process talking over its stdin/stdout, e.g. another build of the engine. Only
+    // implemented on POSIX systems; start() fails elsewhere.
+    class UciProcess {
+    public:
+        UciProcess() = default;
+        ~UciProcess();
+
+        UciProcess(const UciProcess&) = delete;
+        UciProcess& operator=(const UciProcess&) = delete;
+
+        // runs command through the shell; false if it can't be started
+        bool start(const std::string& command);
+        // sends quit and waits briefly before killing the process
+        void stop();
+
+        bool isRunning() const {
+            return pid > 0;
+        }
+
+        bool send(std::string_view line);
+        // the next line of output, or nothing once timeoutMs passes or the process exits
+        std::optional<std::string> readLine(int64_t timeoutMs);
+    private:
+        int pid = -1;
+        int input = -1;  // the child's stdin
+        int output = -1; // the child's stdout
+        std::string buffer;
+    };
+} // namespace choco
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+namespace choco {
+    namespace detail {
+        // splitmix64, so the keys can be generated at compile time
+        constexpr uint64_t nextRandom(uint64_t& state) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        struct ZobristKeys {
+            uint64_t pieces[2][6][64];
+            uint64_t castling[16]; // indexed by GameState::castling
+            uint64_t enpassant[8]; // indexed by file
+            uint64_t blackToMove;
+        };
+
+        constexpr ZobristKeys makeZobristKeys() {
+            ZobristKeys keys{};
+            uint64_t state = 670;
+
+            for (int side = 0; side < 2; side++) {
+                for (int piece = 0; piece < 6; piece++) {
+                    for (int square = 0; square < 64; square++) {
+                        keys.pieces[side][piece][square] = nextRandom(state);
+                    }
+                }
+            }
+
+            for (int i = 0; i < 16; i++) keys.castling[i] = nextRandom(state);
+            for (int i = 0; i < 8; i++) keys.enpassant[i] = nextRandom(state);
+            keys.blackToMove = nextRandom(state);
+
+            return keys;
+        }
+    } // namespace detail
+
+    inline constexpr detail::ZobristKeys ZOBRIST = detail::makeZobristKeys();
+} // namespace choco